@@ -8,21 +8,34 @@
 class BayesFactors{
     public:
 
-    void init(CombinedSpectrum combinedSpectrum);
-    void updateExclusionLine(CombinedSpectrum combinedSpectrum);
+    void init(CombinedSpectrum const& combinedSpectrum);
+    void updateExclusionLine(CombinedSpectrum const& combinedSpectrum);
 
     void step(double stepSize);
 
+    // Bins before dirtyIndex are unchanged since the last markClean(), so only [dirtyIndex, totalBins()) has to be journaled
+    void markClean() { dirtyIndex = totalBins(); }
+
+    // Length of the whole exclusion line, including the bins that have left the window
+    int totalBins() const { return baseIndex + (int)exclusionLine.powers.size(); }
+
 
     // private:
+    // Bin indices are absolute, counted from the start of the scan
     int startIndex=0;
     int cutoffIndex=0;
     double freqRes=0;
+    int dirtyIndex=0;
+    int baseIndex=0;            // Absolute index of the first bin held in exclusionLine, coeffSumA and coeffSumB
     
     double sigmaProc=0.1;
 
     // coefficients in the quadratic formula for the 90% excluded coupling strength
     std::vector<double> coeffSumA, coeffSumB;
 
+    // coeffSumA, coeffSumB and exclusionLine only hold the active window [baseIndex, totalBins()). Bins below startIndex can't be updated 
+    // again, step() moves them to finalizedBins until the owner takes them (ScanRunner::saveState spills them to the state journal). step()
+    // throws rather than let more than MAX_FINALIZED_BINS pile up
     Spectrum exclusionLine;
+    Spectrum finalizedBins;     // Exclusion line of bins [baseIndex - size, baseIndex), oldest first
 };
\ No newline at end of file
@@ -20,6 +20,9 @@ public:
     DataProcessor(){};
     ~DataProcessor(){};
 
+    DataProcessor(const DataProcessor& other);
+    DataProcessor& operator=(const DataProcessor& other);
+
     void displayState();
 
     void setFilterParams(double sampleRate, int poleNumber, double cutoffFrequency, double stopbandAttenuation);
@@ -31,12 +34,15 @@ public:
 
     std::vector<double> removeBadBins(std::vector<double> unfilteredRawSpectrum);
     std::vector<double> trimDC(std::vector<double> untrimmedSpectrum);
+    void maskBadBinsAndDC(std::vector<double>& spectrum);
+    void findDCbins();
 
     void addRawSpectrumToRunningAverage(std::vector<double> rawSpectrum);
+    void addAveragedSpectrumToRunningAverage(const std::vector<double>& averagedSpectrum, int count);
     void updateBaseline();
     void resetBaselining();
 
-    std::vector<std::vector<double>> acquiredToRaw(fftw_complex* rawStream, int spectraPerAcquisition, int samplesPerSpectrum, fftw_plan plan);
+    std::vector<std::vector<double>> acquiredToRaw(fftw_complex* rawStream, int spectraPerAcquisition, int samplesPerSpectrum, fftw_plan plan, fftw_plan batchPlan, int batchSize);
     std::tuple<Spectrum, Spectrum> rawToProcessed(const Spectrum &rawSpectrum);
     Spectrum processedToRescaled(const Spectrum &processedSpectrum);
     void addRescaledToCombined(const Spectrum &rescaledSpectrum, CombinedSpectrum &combinedSpectrum);
@@ -55,7 +61,7 @@ public:
     // DesignClass <int MaxOrder>
     Dsp::FilterDesign <Dsp::ChebyshevII::Design::LowPass<6>, 1> chebyshevFilter;
 
-    double cutoffFrequency_, sampleRate_;
+    double cutoffFrequency_ = 0, sampleRate_ = 0;
 };
 
 
@@ -29,16 +29,25 @@ public:
     void resizeSNRtoMatch(CombinedSpectrum spectrum);
     void setTargets();
 
-    int getDecision(std::vector<double> activeExclusionLine, int numShots);
-    double checkScore(std::vector<double> activeExclusionLine);
+    int getDecision(std::vector<double> const& activeExclusionLine, int numShots);
+    double checkScore(std::vector<double> const& activeExclusionLine);
     void setPoints();
 
+    // Score of the active window (the last trimmedSNR.powers.size() bins of the exclusion line)
+    void updateScore(BayesFactors const& bayesFactors);
+    int getDecision(int numShots);
+    double getScore() const { return score; }
+
     void toggleDecisionMaking(bool decisionMaking);
 
     void saveState(std::string statePath);
 
 private:
     bool decisionMaking = true;
+
+    double binScore(int i, double exclusionPower) const;
+
+    double score = 0;
 };
 
 #endif // DECISION_H
\ No newline at end of file
@@ -21,6 +21,96 @@
 
 #define BUFFER_COUNT (8)
 
+// Pipeline buffer pools, in spectra of samplesPerBuffer fftw_complex (16 bytes each). Hard cap on the memory held between pipeline stages
+#define ACQUISITION_POOL_SIZE (32)
+#define FFT_POOL_SIZE         (64)    // Default of PipelineParameters::fftPoolSize. Must back the FFT queues of both overlapping steps, see
+                                      // ScanRunner::startPipeline, which throws rather than exceed it
+
+// DMA buffers that can wait for the disk while recording raw data (RawStreamRecorder) before the acquisition blocks
+#define RAW_RECORDER_QUEUE_CAPACITY (32)
+
+// State and data snapshots that can wait for the disk (StateSaver) before ScanRunner::saveState and saveData block
+#define SAVE_QUEUE_CAPACITY (8)
+
+// saveState calls between compacted snapshots of the exclusion state journal (StateJournal). In between only the changed bins are written
+#define JOURNAL_SNAPSHOT_INTERVAL (64)
+
+// Finalized exclusion line bins BayesFactors::step may leave waiting for their owner to spill them (ScanRunner::saveState). Stepping again
+// with more than this waiting throws, so a caller that steps without saving can't grow memory without bound
+#define MAX_FINALIZED_BINS (1 << 20)
+
+// Metrics registry export (MetricsExporter). Prometheus text replaces the file every export, JSON lines appends one line per export
+#define METRICS_PROMETHEUS      (0)
+#define METRICS_JSON_LINES      (1)
+#define METRICS_EXPORT_INTERVAL (10.0)  // Seconds
+#define METRICS_DEFAULT_BUCKETS (12)    // Histogram buckets from 10 us in steps of 4x, up to about 42 s
+
+// Replace the magnitude and averaging threads with one thread that accumulates power straight from the FFT output (accumulationThread)
+#define FUSED_ACCUMULATION    (0)
+
+// Buffers transformed per FFT call. Each pool block holds this many contiguous buffers, which are run through one fftw_plan_many_dft plan
+#define FFT_BATCH             (4)
+
+// Parallel FFT workers, each with its own raw and FFT queue lane
+#define FFT_THREADS           (2)
+
+// Pipeline queues (SPSCQueue in utils/multiThreading.hpp)
+#define CACHE_LINE_SIZE         (64)
+#define PIPELINE_QUEUE_CAPACITY (64)    // Slots per queue, rounded up to a power of 2
+#define BUFFER_QUEUE_CAPACITY   (16)    // Default for the raw and FFT queues, in spectra. They hold pool blocks of fftBatch spectra each
+#define SPSC_SPIN_COUNT         (2000)  // Busy checks before a blocked side starts yielding
+#define SPSC_YIELD_COUNT        (50)    // Yielding checks before it sleeps on the condition variable
+
+// Pipeline queue codes, in pipeline order
+#define QUEUE_RAW           (0)
+#define QUEUE_FFT           (1)
+#define QUEUE_MAG           (2)
+#define QUEUE_PROC          (3)
+#define QUEUE_DECISION      (4)
+#define NUM_QUEUES          (5)
+
+// What a push does when its queue is full
+#define QUEUE_BLOCK         (0)     // Wait for the consumer (back pressure)
+#define QUEUE_DROP_OLDEST   (1)     // Discard the oldest queued element
+#define QUEUE_FLAG_OVERFLOW (2)     // Raise the pipeline overflow flag, which ends the acquisition, then wait
+
+// Pipeline worker roles (WorkerPool in utils/workerPool.hpp). Each role has its own CPU affinity and priority in PipelineParameters
+#define WORKER_ACQUISITION  (0)
+#define WORKER_FFT          (1)
+#define WORKER_SPECTRUM     (2)     // Magnitude and averaging, or the fused accumulation thread
+#define WORKER_PROCESSING   (3)
+#define WORKER_DECISION     (4)
+#define NUM_WORKER_ROLES    (5)
+
+// Worker priorities, the values of the Windows THREAD_PRIORITY_* constants. Only applied on Windows
+#define WORKER_PRIORITY_LOWEST          (-2)
+#define WORKER_PRIORITY_BELOW_NORMAL    (-1)
+#define WORKER_PRIORITY_NORMAL          (0)
+#define WORKER_PRIORITY_ABOVE_NORMAL    (1)
+#define WORKER_PRIORITY_HIGHEST         (2)
+#define WORKER_PRIORITY_TIME_CRITICAL   (15)
+
+// Digitizer backend. Set to 1 to run against the software board in instruments/simulatedATS.hpp instead of the Alazar card
+#ifndef SIMULATED_ATS
+#define SIMULATED_ATS (0)
+#endif
+
+// Precision of the streaming pipeline: conversion, FFT and magnitude. Set to 1 to run them in float with fftwf. Averaging and everything after
+// it is double either way. The calibration path (AcquireData, acquiredToRaw) is always double
+#ifndef SINGLE_PRECISION_PIPELINE
+#define SINGLE_PRECISION_PIPELINE (0)
+#endif
+
+// Alazar card support: the Alazar headers and the ATS class. Off by default away from Windows, where ScanRunner can only run on the simulated
+// board (SIMULATED_ATS). The core library (CORE_SOURCES in src/CMakeLists.txt) is always built without it
+#ifndef ACQUISITION_SUPPORT
+#ifdef _WIN32
+#define ACQUISITION_SUPPORT (1)
+#else
+#define ACQUISITION_SUPPORT (0)
+#endif
+#endif
+
 #define _USE_MATH_DEFINES
 
 // Timers
@@ -31,13 +121,36 @@
 #define TIMER_PROCESS       (4)
 #define TIMER_DECISION      (5)
 #define TIMER_SAVE          (6)
-#define NUM_TIMERS          (7)
+#define TIMER_STEP          (7)     // Time the board sits idle between the acquisitions of ScanRunner::runSteps
+#define NUM_TIMERS          (8)
+
+// Per call timer histograms (timing.cpp). Calls under 16 ns get a bucket per ns, above that each power of two is split into 8 buckets, so
+// percentiles are within 12.5%. The last bucket also holds anything longer than about an hour
+#define TIMER_HISTOGRAM_BUCKETS (320)
 
 // Per spectrum timing
 #define ACQUIRED_SPECTRA (0)
 #define SPECTRA_AT_DECISION (1)
 #define SPECTRUM_AVERAGE_SIZE (2)
-#define NUM_METRICS (3)
+#define SAVE_QUEUE_DEPTH (3)    // Snapshots waiting for the disk, one entry per StateSaver::submit
+#define NUM_METRICS (4)
+
+// Pipeline trace stages (trace.cpp), in pipeline order
+#define TRACE_ACQUISITION   (0)
+#define TRACE_FFT           (1)
+#define TRACE_MAGNITUDE     (2)     // Magnitude thread, or the per sub-spectrum half of the fused accumulation thread
+#define TRACE_AVERAGE       (3)
+#define TRACE_PROCESS       (4)
+#define TRACE_DECISION      (5)
+#define NUM_TRACE_STAGES    (6)
+
+// What a trace event marks
+#define TRACE_ENQUEUE       (0)     // Pushed to the input queue of the stage
+#define TRACE_DEQUEUE       (1)     // Popped by the stage
+#define TRACE_FINISH        (2)     // The stage is done with it
+
+// Acquisition to decision latency histogram. Bucket 0 counts latencies below 1 us, bucket n those in [2^(n-1), 2^n) us
+#define TRACE_LATENCY_BUCKETS (32)
 
 // Data saving flags
 #define SAVE_PROGRESS (0)
@@ -51,12 +164,18 @@
 
 // Standard library includes
 #include <stdio.h>
-#include <crtdbg.h> // for leak detection
-#include <conio.h>
 #include <cmath>
 #include <algorithm>
 #include <numeric>
+#include <ctime>
+#include <cstdio>
+
+// Platform headers. The core library reaches the OS through platform.cpp and MappedFile instead of using these directly
+#ifdef _WIN32
+#include <crtdbg.h> // for leak detection
+#include <conio.h>
 #include <windows.h>
+#endif
 
 #include <iostream>
 #include <fstream>
@@ -66,18 +185,22 @@
 #include <string>
 #include <vector>
 #include <queue>
+#include <map>
 #include <complex>
 #include <iterator>
+#include <random>
 
 #include <chrono>
 #include <stdexcept>
 #include <future>
+#include <functional>
 
 #include <thread>
 #include <condition_variable>
 #include <mutex>
 #include <memory>
 #include <atomic>
+#include <cstdint>
 
 
 // Custom library includes
@@ -86,10 +209,21 @@
 #include "utils/json.hpp"
 using json = nlohmann::json;
 
+#if ACQUISITION_SUPPORT
 #include "AlazarError.h"
 #include "AlazarApi.h"
 #include "AlazarCmd.h"
 #include "IoBuffer.h"
+#else
+// Sample types of AlazarApi.h, for the simulated board, raw streams and sample conversion without the Alazar headers. U32 is an unsigned
+// long there, which is only 32 bits on Windows
+typedef unsigned short  U16;
+#ifdef _WIN32
+typedef unsigned long   U32;
+#else
+typedef std::uint32_t   U32;
+#endif
+#endif
 
 // #include "H5Cpp.h"
 
@@ -102,6 +236,35 @@ using json = nlohmann::json;
  * STRUCTS AND GLOBALS                                                        *
  *                                                                            *
  ******************************************************************************/
+// Sample, complex and plan types of the streaming pipeline, see SINGLE_PRECISION_PIPELINE
+#if SINGLE_PRECISION_PIPELINE
+typedef float           pipeline_real;
+typedef fftwf_complex   pipeline_complex;
+typedef fftwf_plan      pipeline_plan;
+#else
+typedef double          pipeline_real;
+typedef fftw_complex    pipeline_complex;
+typedef fftw_plan       pipeline_plan;
+#endif
+
+/**
+ * @brief Struct for storing acquisition parameters. Set by the digitizer's setAcquisitionParameters() method and accessed throughout the class.
+ * 
+ */
+struct AcquisitionParameters {
+    U32 sampleRate;
+    U32 samplesPerAcquisition;
+    U32 buffersPerAcquisition;
+    U32 recordsPerAcquisition;
+
+    double inputRange;
+    double inputImpedance;
+
+    U32 samplesPerBuffer;
+    U32 bytesPerSample;
+    U32 bytesPerBuffer;
+};
+
 // Structs for scanning parameters
 struct TopLevelParameters {
     bool decisionMaking;
@@ -129,19 +292,70 @@ struct FilterParameters {
     double stopbandAttenuation;
 };
 
+// Capacity and full policy of each pipeline queue, indexed by QUEUE_* code. The raw and FFT capacities are in spectra, rounded up to whole
+// pool blocks of fftBatch spectra and shared between the FFT worker lanes
+struct PipelineParameters {
+    int queueCapacity[NUM_QUEUES];
+    int queuePolicy[NUM_QUEUES];
+    int fftThreads;
+    int fftBatch;
+    int fftPoolSize;            // Spectra the FFT buffer pool may hold, a hard cap on its memory
+    bool fusedAccumulation;
+
+    std::string recordPath;     // Folder to record the raw DMA buffers of each acquisition to, empty to not record
+    std::string replayPath;     // Raw stream file the simulated board plays back instead of synthesizing data (SIMULATED_ATS only, also on Linux)
+    double replaySpeed;         // Playback rate as a multiple of the sample rate, 0 to play back as fast as possible
+
+    unsigned long long workerAffinity[NUM_WORKER_ROLES];    // CPU mask (bit n = logical CPU n) per WORKER_* role, 0 to leave it to the OS
+    int workerPriority[NUM_WORKER_ROLES];                   // WORKER_PRIORITY_* per WORKER_* role
+
+    int traceCapacity;          // Events the pipeline trace can hold, 0 to not trace
+    std::string tracePath;      // Folder the Chrome trace JSON is written to when the ScanRunner is destroyed, empty to not write it
+
+    std::string metricsPath;    // File the metrics registry is exported to while the ScanRunner exists, empty to not export
+    int metricsFormat;          // METRICS_PROMETHEUS or METRICS_JSON_LINES
+    double metricsInterval;     // Seconds between exports
+
+    PipelineParameters() : fftThreads(FFT_THREADS), fftBatch(FFT_BATCH), fftPoolSize(FFT_POOL_SIZE), fusedAccumulation(FUSED_ACCUMULATION), replaySpeed(1), traceCapacity(0),
+                           metricsFormat(METRICS_PROMETHEUS), metricsInterval(METRICS_EXPORT_INTERVAL) {
+        for (int n = 0; n < NUM_QUEUES; n++) {
+            queueCapacity[n] = PIPELINE_QUEUE_CAPACITY;
+            queuePolicy[n] = QUEUE_BLOCK;
+        }
+        for (int n = 0; n < NUM_WORKER_ROLES; n++) {
+            workerAffinity[n] = 0;
+            workerPriority[n] = WORKER_PRIORITY_NORMAL;
+        }
+        queueCapacity[QUEUE_RAW] = BUFFER_QUEUE_CAPACITY;
+        queueCapacity[QUEUE_FFT] = BUFFER_QUEUE_CAPACITY;
+    }
+};
+
 struct ScanParameters {
     TopLevelParameters topLevelParameters;
     DataParameters dataParameters;
     FilterParameters filterParameters;
+    PipelineParameters pipelineParameters;
 };
 
 
+// Identifies the DMA buffers a pipeline block or spectrum was made from, for the pipeline trace (trace.cpp)
+struct TraceTag {
+    int step = 0;                       // Acquisition the buffers belong to, counted per ScanRunner
+    std::uint64_t firstBuffer = 0;      // Index of the first buffer within its acquisition
+    std::uint32_t bufferCount = 0;
+    std::int64_t firstAcquiredTime = 0; // traceClock() when the board handed over the first of the buffers
+    std::int64_t acquiredTime = 0;      // and the last
+};
+
 // Struct for holding spectrum information
 struct Spectrum {
     std::vector<double> powers;
     std::vector<double> freqAxis;
     
     double trueCenterFreq;
+
+    TraceTag tag;
 };
 
 struct CombinedSpectrum : public Spectrum {
@@ -187,6 +401,28 @@ struct SharedDataSaving {
     std::condition_variable averagedSpectrumReadyCondition;
 };
 
+// Counters kept by each pipeline queue. Times are in seconds
+struct QueueStats {
+    size_t capacity = 0;
+    size_t pushed = 0;
+    size_t maxDepth = 0;        // High-watermark of queued elements
+    size_t overflows = 0;       // Pushes that found the queue full
+    size_t drops = 0;           // Elements discarded under QUEUE_DROP_OLDEST
+    double pushBlockedTime = 0; // Producer waiting on a full queue
+    double popWaitTime = 0;     // Consumer waiting on an empty queue
+};
+
+// Totals of one TIMER_* stage over every thread that timed it. Times are in seconds, percentiles are per call
+struct TimerStats {
+    double total = 0;
+    std::uint64_t calls = 0;
+    std::uint64_t items = 0;    // Blocks, spectra or snapshots handled, depending on the stage
+    double p50 = 0;
+    double p99 = 0;
+    double maxTime = 0;
+    double throughput = 0;      // Items per second of stage time
+};
+
 struct AveragedData {
     std::vector<double> collatedData;
     size_t numSpectra;
@@ -236,14 +472,27 @@ struct SynchronizationFlags {
 
 // Class includes
 #include "utils/multiThreading.hpp"
-
+#include "utils/bufferPool.hpp"
+#include "utils/workerPool.hpp"
+#include "utils/mappedFile.hpp"
+#include "utils/stateJournal.hpp"
+#include "utils/stateSaver.hpp"
+#include "utils/trace.hpp"
+#include "utils/metricsRegistry.hpp"
+
+#if ACQUISITION_SUPPORT
 #include "instruments/ATS.hpp"
+#endif
+#include "utils/rawStream.hpp"
+#include "instruments/simulatedATS.hpp"
 
 #include "dataProcessing/bayes.hpp"
 #include "dataProcessing/dataProcessor.hpp"
 
 #include "decisionAgent.hpp"
+#if ACQUISITION_SUPPORT || SIMULATED_ATS
 #include "scanRunner.hpp"
+#endif
 
 
 /*******************************************************************************
@@ -261,6 +510,10 @@ void unwrapPhase(std::vector<double>& phase);
 std::tuple<double, double> vectorStats(std::vector<double> vec);
 void trimVector(std::vector<double>& vec, double cutPercentage);
 void trimSpectrum(Spectrum& spec, double cutPercentage);
+fftw_plan planFFTBatch(int samplesPerSpectrum, int batchSize, unsigned flags);
+fftwf_plan planFFTBatchFloat(int samplesPerSpectrum, int batchSize, unsigned flags);
+void executeFFTBatch(fftw_plan plan, fftw_plan batchPlan, int batchSize, int samplesPerSpectrum, fftw_complex* input, fftw_complex* output, int count);
+void executeFFTBatch(fftwf_plan plan, fftwf_plan batchPlan, int batchSize, int samplesPerSpectrum, fftwf_complex* input, fftwf_complex* output, int count);
 
 // fileIO.cpp
 std::vector<std::vector<double>> readCSV(std::string filename, int maxLines);
@@ -278,29 +531,68 @@ double formatWithPrecision(double value, int precision);
 
 // mexUtils.cpp
 ScanParameters unpackScanParameters(json const& inputParams);
+int parseQueuePolicy(std::string const& policy);
+int parseWorkerPriority(json const& priority);
 
 // multiThreading.cpp
-void fftThread(fftw_plan plan, int samplesPerSpectrum, ThreadSafeQueue<fftw_complex*>& inputQueue, ThreadSafeQueue<fftw_complex*>& outputQueue);
-void magnitudeThread(int samplesPerSpectrum, DataProcessor& dataProcessor, ThreadSafeQueue<fftw_complex*>& inputQueue, ThreadSafeQueue<std::vector<double>>& outputQueue);
-void averagingThread(DataProcessor& dataProcessor, double trueCenterFreq, ThreadSafeQueue<std::vector<double>>& inputQueue, ThreadSafeQueue<Spectrum>& outputQueue, int subSpectraAveragingNumber);
-void processingThread(DataProcessor& dataProcessor, ThreadSafeQueue<Spectrum>& inputQueue, ThreadSafeQueue<CombinedSpectrum>& outputQueue);
-void decisionMakingThread(BayesFactors& bayesFactors, DecisionAgent& decisionAgent, ThreadSafeQueue<CombinedSpectrum>& inputQueue, std::atomic<bool>& triggerEnd);
+void fftThread(pipeline_plan plan, pipeline_plan batchPlan, int batchSize, int samplesPerSpectrum, PipelineQueue<PooledBuffer>& inputQueue, PipelineQueue<PooledBuffer>& outputQueue, BufferPool& outputPool);
+void magnitudeThread(int samplesPerSpectrum, DataProcessor& dataProcessor, LanedQueue<PooledBuffer>& inputQueue, PipelineQueue<Spectrum>& outputQueue);
+void averagingThread(DataProcessor& dataProcessor, double trueCenterFreq, PipelineQueue<Spectrum>& inputQueue, PipelineQueue<Spectrum>& outputQueue, int subSpectraAveragingNumber);
+void accumulationThread(int samplesPerSpectrum, DataProcessor& dataProcessor, double trueCenterFreq, LanedQueue<PooledBuffer>& inputQueue, PipelineQueue<Spectrum>& outputQueue, int subSpectraAveragingNumber);
+void processingThread(DataProcessor& dataProcessor, PipelineQueue<Spectrum>& inputQueue, PipelineQueue<CombinedSpectrum>& outputQueue);
+void decisionMakingThread(BayesFactors& bayesFactors, DecisionAgent& decisionAgent, PipelineQueue<CombinedSpectrum>& inputQueue, std::atomic<bool>& triggerEnd);
+
+// platform.cpp
+bool keyPressed();
+bool listFiles(const std::string& folderPath, std::vector<std::string>& files);
+std::tm localTime(std::time_t time);
+bool syncFile(std::FILE* file);
+bool truncateFile(std::FILE* file, std::uint64_t bytes);
+bool replaceFile(std::string const& source, std::string const& target, bool durable = false);
+bool setThreadAffinity(unsigned long long affinityMask);
+bool setThreadPriority(int priority);
+
+// sampleConversion.cpp
+void convertSamplesToComplex(const U16* samplesA, const U16* samplesB, fftw_complex* output, U32 numSamples, double inputRange, U32 firstIndex);
+void convertSamplesToComplex(const U16* samplesA, const U16* samplesB, fftwf_complex* output, U32 numSamples, double inputRange, U32 firstIndex);
 
 // tests.cpp
 void printAvailableResources();
 void psgTesting(int gpibAdress);
 void awgTesting(int gpibAdress);
 
+// trace.cpp
+std::int64_t traceClock();
+void startTrace(size_t capacity);
+bool traceEnabled();
+void traceEvent(TraceTag const& tag, int stage, int kind);
+TraceTag bufferTag(TraceTag const& tag, int index);
+TraceTag mergeTags(TraceTag const& first, TraceTag const& last);
+std::vector<TraceEvent> getTraceEvents();
+void reportLatency();
+json latencyToJson();
+void saveChromeTrace(std::string const& filename);
+
+// metricsRegistry.cpp
+MetricsRegistry& metricsRegistry();
+std::vector<double> exponentialBuckets(double start, double factor, int count);
+AcquisitionMetrics& acquisitionMetrics();
+MetricGauge& badBinsGauge();
+
 //timing.cpp
 void setTime(int timerCode, double val);
 double getTime(int timerCode);
 void startTimer(int timerCode);
-void stopTimer(int timerCode);
+void stopTimer(int timerCode, std::uint64_t items = 1);
+void addTime(int timerCode, double seconds, std::uint64_t items = 1);
+TimerStats getTimerStats(int timerCode);
 void resetTimers();
 void resetMetrics();
 void setMetric(int metricCode, int val);
 void updateMetric(int metricCode, int val);
 std::vector<int> getMetric(int metricCode);
+void recordQueueStats(int queueCode, QueueStats stats);
+QueueStats getQueueStats(int queueCode);
 void reportPerformance();
 json performanceToJson();
 
@@ -14,23 +14,7 @@
 
 #include "decs.hpp"
 
-/**
- * @brief Struct for storing acquisition parameters. Set by setAcquisitionParameters() method and accessed throughout the class.
- * 
- */
-struct AcquisitionParameters {
-    U32 sampleRate;
-    U32 samplesPerAcquisition;
-    U32 buffersPerAcquisition;
-    U32 recordsPerAcquisition;
-
-    double inputRange;
-    double inputImpedance;
-
-    U32 samplesPerBuffer;
-    U32 bytesPerSample;
-    U32 bytesPerBuffer;
-};
+class RawStreamRecorder;
 
 /**
  * @brief Class for controlling alazarCard. Implements methods for acquiring data and setting acquisition parameters. 
@@ -48,7 +32,7 @@ public:
     void toggleLowPass(char channel, bool enable);
 
     fftw_complex* AcquireData();
-    void AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& outputQueue, std::atomic<bool>& triggerEnd);
+    void AcquireDataMultithreadedContinuous(LanedQueue<PooledBuffer>& outputQueue, BufferPool& bufferPool, std::atomic<bool>& triggerEnd, std::atomic<bool>& pipelineOverflow, RawStreamRecorder* recorder = nullptr, int traceStep = 0);
 
     U32 suggestBufferNumber(U32 sampleRate, U32 samplesPerAcquisition);
     void printBufferSize(U32 samplesPerAcquisition, U32 buffersPerAcquisition);
@@ -0,0 +1,109 @@
+/**
+ * @file simulatedATS.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definition for SimulatedATS class. A software stand-in for the AlazarTech ATS9462 that produces synthetic dual-channel
+ *        U16 samples, or replays a recorded acquisition, so the acquisition pipeline can be exercised and benchmarked without the card.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef SIMULATED_ATS_H
+#define SIMULATED_ATS_H
+
+#include "decs.hpp"
+
+/**
+ * @brief Struct for storing the parameters of the synthetic signal. All IF frequencies are in MHz relative to the center frequency,
+ * absolute frequencies are in MHz. Voltages are per channel, in the same units as the card's input range.
+ *
+ */
+struct SimulationParameters {
+    bool realTime = false;                  // Pace buffers at the configured sample rate. If false, run as fast as possible
+    double speed = 1;                       // Multiple of the sample rate buffers are paced at in realTime mode
+    unsigned int seed = 1;                  // Seed for the noise generator
+    int uniqueBuffers = 0;                  // 0 synthesizes fresh noise for every buffer. Above 1, buffers are drawn from a bank of this many
+                                            // pre-generated realizations, which is cheaper but leaves a fixed pattern (throughput testing only)
+
+    double noiseAmplitude = 0.05;           // RMS noise per channel (V) where the baseline gain is 1
+
+    // Cavity/amplifier baseline shape
+    double amplifierRollOff = 12;           // -3 dB point of a 4th order roll off (MHz)
+    double rippleAmplitude = 0.05;          // Fractional standing wave ripple on the gain
+    double ripplePeriod = 1.3;              // Period of the standing wave ripple (MHz)
+    double cavityContrast = 0.5;            // Fractional excess noise on resonance
+    double cavityLinewidth = 0.5;           // Cavity FWHM (MHz)
+    double cavityOffset = 0;                // Cavity resonance relative to the center frequency (MHz)
+
+    // Coherent RFI spurs
+    std::vector<double> spurFrequencies = {-7.25, -3.1, 2.5, 6.0};
+    double spurAmplitude = 2e-3;            // Amplitude of each spur (V)
+
+    // Axion-like line (Maxwellian lineshape in absolute frequency)
+    bool injectAxion = false;
+    double axionFrequency = 0;              // Onset of the line (MHz)
+    double axionLinewidth = 5e-3;           // Width of the line (MHz)
+    double axionPower = 0.05;               // Peak excess power as a fraction of the local noise power
+
+    double centerFrequency = 0;             // Current center frequency (MHz), used to place the axion line in the IF band
+
+    // Replay of a recorded acquisition (RawStreamRecorder). Replaces all of the synthetic signal above, and loops if the file is shorter
+    // than the acquisition
+    std::string replayPath;                 // Raw stream file to play back, empty to synthesize
+};
+
+
+/**
+ * @brief Class for simulating the alazarCard. Implements the same acquisition interface as ATS (setAcquisitionParameters, AcquireData and
+ * AcquireDataMultithreadedContinuous) so it can be swapped in with the SIMULATED_ATS flag. Function definitions and documentation are in
+ * simulatedATS.cpp.
+ *
+ */
+class SimulatedATS {
+public:
+    SimulatedATS(int systemId = 1, int boardId = 1);
+    ~SimulatedATS();
+
+    void setAcquisitionParameters(U32 sampleRate, U32 samplesPerAcquisition, U32 buffersPerAcquisition=1, double inputRange=0.8, double inputImpedance=50);
+
+    fftw_complex* AcquireData();
+    void AcquireDataMultithreadedContinuous(LanedQueue<PooledBuffer>& outputQueue, BufferPool& bufferPool, std::atomic<bool>& triggerEnd, std::atomic<bool>& pipelineOverflow, RawStreamRecorder* recorder = nullptr, int traceStep = 0);
+
+    U32 suggestBufferNumber(U32 sampleRate, U32 samplesPerAcquisition);
+    void printBufferSize(U32 samplesPerAcquisition, U32 buffersPerAcquisition);
+
+    void refreshSimulation();
+
+    AcquisitionParameters acquisitionParams;
+    SimulationParameters simParams;
+
+private:
+    std::mt19937 generator;
+
+    std::vector<float> noiseAmplitudes;
+    fftwf_complex* noiseSpectrum = nullptr;
+    fftwf_complex* noiseTimeSeries = nullptr;
+    fftwf_plan noisePlan = nullptr;
+    int noisePlanSize = 0;
+
+    std::vector<std::vector<std::complex<float>>> noiseBank;
+    std::vector<std::complex<float>> spurBuffer;
+    std::vector<U16> dmaBuffers[BUFFER_COUNT];
+
+    bool bankValid = false;
+    double bankCenterFrequency = 0;
+
+    RawStreamReplay replay;
+
+    void prepareSource();
+    const U16* nextBuffer(U32 bufferIndex);
+    void prepareBank();
+    void synthesizeNoise();
+    double baselineGain(double ifFrequency);
+    double axionShape(double absFrequency);
+    void fillBuffer(U16* buffer);
+};
+
+#endif // SIMULATED_ATS_H
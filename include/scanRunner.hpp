@@ -20,6 +20,34 @@
 #define PSG_PROBE (2)
 #define NUM_PSGS  (3)
 
+// Acquisition backend, see SIMULATED_ATS in decs.hpp
+#if SIMULATED_ATS
+typedef SimulatedATS Digitizer;
+#else
+typedef ATS Digitizer;
+#endif
+
+/**
+ * @brief Queues, workers and per step state of one acquisition pipeline. ScanRunner keeps two so one step can finish processing while the
+ * next one acquires. Each has its own copy of the DataProcessor, so overlapping steps never share a running average or filter state.
+ *
+ */
+struct PipelineContext {
+    DataProcessor dataProcessor;
+    double trueCenterFreq = 0;
+
+    std::atomic<bool> triggerEnd;
+    std::atomic<bool> pipelineOverflow;
+
+    std::unique_ptr<LanedQueue<PooledBuffer>> rawQueue;
+    std::unique_ptr<LanedQueue<PooledBuffer>> fftQueue;
+    std::unique_ptr<PipelineQueue<Spectrum>> magQueue;
+    std::unique_ptr<PipelineQueue<Spectrum>> procQueue;
+    std::unique_ptr<PipelineQueue<CombinedSpectrum>> decisionQueue;
+
+    WorkerPool workers;     // Persistent threads of the stages, re-armed every step
+};
+
 #define NO_FAXION     (0)
 #define SHARP_FAXION  (1)
 #define BROAD_FAXION  (2)
@@ -37,7 +65,9 @@ public:
     void acquireData();
     void unrolledAcquisition();
     void step(double stepSize);
+    void runSteps(int steps, double stepSize, int saveDataEvery = 0);
     void saveData();
+    void waitForSaves();
     void flushData();
 
     void refreshBaselineAndBadBins(int repeats = 3, int subSpectra = 32, int savePlots = 0);
@@ -52,14 +82,42 @@ public:
 
 private:
     // Member classes
-    ATS alazarCard;
+    Digitizer alazarCard;
     fftw_plan fftwPlan;
+    fftw_plan fftwBatchPlan;
+    pipeline_plan pipelinePlan;         // Same as fftwPlan unless SINGLE_PRECISION_PIPELINE is set
+    pipeline_plan pipelineBatchPlan;
+    int fftBatch;
     DataProcessor dataProcessor;
 
     // Threaded structs
     SavedData savedData;
     BayesFactors bayesFactors;
 
+    // Pipeline buffers, kept across acquireData calls
+    BufferPool acquisitionPool;
+    BufferPool fftPool;
+
+    // Baseline from the last calibration, every step starts from it
+    std::vector<double> calibratedBaseline;
+
+    // Two so runSteps can start the next step while the last one drains
+    PipelineContext pipelines[2];
+
+    // Raw DMA buffer recording, see PipelineParameters::recordPath
+    RawStreamRecorder rawRecorder;
+    int rawRecordingCount;
+
+    // Acquisitions started, numbers the steps of the pipeline trace
+    int stepsStarted;
+
+    // Writes saveState and saveData snapshots off the scan thread
+    StateSaver stateSaver;
+    int savesSinceSnapshot;     // saveState calls since the last full snapshot of the state journal
+
+    // Writes metricsRegistry() to PipelineParameters::metricsPath
+    MetricsExporter metricsExporter;
+
 
     // Private methods
     void initAlazarCard();
@@ -67,6 +125,11 @@ private:
     void initProcessor();
     void initDecisionAgent();
 
+    void startPipeline(PipelineContext& pipeline, double trueCenterFreq);
+    void startDecisions(PipelineContext& pipeline);
+    void finishAcquisition(PipelineContext& pipeline);
+    void finishPipeline(PipelineContext& pipeline);
+
     void acquireProcCalibration(int repeats = 3, int subSpectra = 32, int savePlots = 0);
 };
 
@@ -0,0 +1,97 @@
+/**
+ * @file bufferPool.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definitions for BufferPool and PooledBuffer. A bounded pool of FFTW aligned pipeline_complex blocks that are handed through the
+ *        pipeline queues as move-only handles, so buffers are allocated once and total pipeline memory has a hard cap. pipeline_complex is
+ *        fftwf_complex when SINGLE_PRECISION_PIPELINE is set, which halves the pool memory.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include "decs.hpp"
+
+class BufferPool;
+
+/**
+ * @brief Owning handle to one block of a BufferPool. The block goes back to its pool when the handle is destroyed or released. Handles can
+ * be moved (e.g. through a PipelineQueue) but not copied. A default constructed handle is empty and is used to signal an unexpected end
+ * of the acquisition.
+ *
+ */
+class PooledBuffer {
+public:
+    PooledBuffer();
+    ~PooledBuffer();
+
+    PooledBuffer(PooledBuffer&& other);
+    PooledBuffer& operator=(PooledBuffer&& other);
+
+    PooledBuffer(const PooledBuffer& other) = delete;
+    PooledBuffer& operator=(const PooledBuffer& other) = delete;
+
+    pipeline_complex* get() const { return data; }
+    bool empty() const { return data == nullptr; }
+
+    void release();
+
+    size_t sequence;    // Position of the block in the acquisition, set by the producer and carried through the FFT so results can be put back in order
+    size_t count;       // Number of samplesPerBuffer spectra filled, up to the batch size. Only the last block of an acquisition is short
+    TraceTag tag;       // Buffers of the acquisition the block holds, set by the producer when the block is pushed
+
+private:
+    friend class BufferPool;
+    PooledBuffer(BufferPool* pool, pipeline_complex* data);
+
+    BufferPool* pool;
+    pipeline_complex* data;
+};
+
+
+/**
+ * @brief Thread safe pool of at most capacity blocks of blockSize pipeline_complex. Blocks are allocated with fftw_malloc the first time they
+ * are needed and kept until the pool is reconfigured or destroyed. acquire() blocks while every block is in use, which applies back pressure
+ * to the producer instead of growing memory. Function definitions and documentation are in bufferPool.cpp.
+ *
+ * @warning The pool must outlive every handle it has given out.
+ *
+ */
+class BufferPool {
+public:
+    BufferPool(size_t blockSize = 0, size_t capacity = 0);
+    ~BufferPool();
+
+    BufferPool(const BufferPool& other) = delete;
+    BufferPool& operator=(const BufferPool& other) = delete;
+
+    void configure(size_t blockSize, size_t capacity);
+
+    PooledBuffer acquire();
+    bool tryAcquire(PooledBuffer& buffer);
+
+    size_t getBlockSize() const { return blockSize; }
+    size_t getCapacity() const { return capacity; }
+    size_t available() const;
+
+private:
+    friend class PooledBuffer;
+    void giveBack(pipeline_complex* block);
+    void freeBlocks();
+
+    mutable std::mutex mtx;
+    std::condition_variable blockReturned;
+
+    size_t blockSize;
+    size_t capacity;
+    size_t allocated;
+
+    std::vector<pipeline_complex*> freeList;
+    std::vector<pipeline_complex*> allBlocks;
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,47 @@
+/**
+ * @file mappedFile.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definition for MappedFile, a read only memory map of a whole file. Used to read raw stream recordings and the state journal
+ *        without copying them.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "decs.hpp"
+
+/**
+ * @brief Read only, sequential access memory map of a file. Function definitions and documentation are in mappedFile.cpp.
+ *
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    void open(std::string const& filename);
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    const char* data() const { return mapping; }
+    size_t size() const { return mappedBytes; }
+
+private:
+    const char* mapping;
+    size_t mappedBytes;
+
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+};
+
+#endif // MAPPED_FILE_H
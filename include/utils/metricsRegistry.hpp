@@ -0,0 +1,191 @@
+/**
+ * @file metricsRegistry.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definitions for the named metrics registry and its file exporter. Any module can register counters, gauges and histograms by
+ *        name and update them from any thread without locking. MetricsExporter periodically writes the registry to a Prometheus text file or
+ *        appends it to a JSON lines file, so a long scan can be watched from outside the process.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef METRICS_REGISTRY_H
+#define METRICS_REGISTRY_H
+
+#include "decs.hpp"
+
+/**
+ * @brief Base of the registered metrics. Holds the name and help text and writes the current value in either export format.
+ *
+ */
+class Metric {
+public:
+    Metric(std::string const& name, std::string const& help) : name(name), help(help) {}
+    virtual ~Metric() {}
+
+    Metric(const Metric& other) = delete;
+    Metric& operator=(const Metric& other) = delete;
+
+    virtual const char* typeName() const = 0;
+    virtual void writePrometheus(std::ostream& out) const = 0;
+    virtual json toJson() const = 0;
+
+    std::string const& getName() const { return name; }
+    std::string const& getHelp() const { return help; }
+
+protected:
+    std::string name;
+    std::string help;
+};
+
+
+/**
+ * @brief Monotonic count, e.g. buffers acquired. Only goes up, rates are worked out by whoever reads the export.
+ *
+ */
+class MetricCounter : public Metric {
+public:
+    MetricCounter(std::string const& name, std::string const& help) : Metric(name, help), count(0) {}
+
+    void add(std::uint64_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t get() const { return count.load(std::memory_order_relaxed); }
+
+    const char* typeName() const override { return "counter"; }
+    void writePrometheus(std::ostream& out) const override;
+    json toJson() const override { return get(); }
+
+private:
+    std::atomic<std::uint64_t> count;
+};
+
+
+/**
+ * @brief Value that can go up and down, e.g. a queue depth. The last set() wins.
+ *
+ */
+class MetricGauge : public Metric {
+public:
+    MetricGauge(std::string const& name, std::string const& help) : Metric(name, help), value(0.0) {}
+
+    void set(double newValue) { value.store(newValue, std::memory_order_relaxed); }
+    void add(double delta);
+    double get() const { return value.load(std::memory_order_relaxed); }
+
+    const char* typeName() const override { return "gauge"; }
+    void writePrometheus(std::ostream& out) const override;
+    json toJson() const override { return get(); }
+
+private:
+    std::atomic<double> value;
+};
+
+
+/**
+ * @brief Distribution of observed values over fixed buckets, e.g. FFT batch times. Bucket n counts values at or below bounds[n] and above
+ * the bound before it, the last bucket counts everything above the last bound.
+ *
+ */
+class MetricHistogram : public Metric {
+public:
+    MetricHistogram(std::string const& name, std::string const& help, std::vector<double> const& bounds);
+
+    void observe(double value);
+
+    std::vector<double> const& getBounds() const { return bounds; }
+    std::uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+    double getSum() const { return sum.load(std::memory_order_relaxed); }
+
+    const char* typeName() const override { return "histogram"; }
+    void writePrometheus(std::ostream& out) const override;
+    json toJson() const override;
+
+private:
+    std::vector<double> bounds;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> buckets;     // bounds.size() + 1
+    std::atomic<std::uint64_t> count;
+    std::atomic<double> sum;
+};
+
+
+/**
+ * @brief Owns the metrics by name. Registering takes a lock, so callers look a metric up once and keep the reference, which stays valid for
+ * the life of the registry. Asking for an existing name returns the same metric, so modules don't have to coordinate who registers first.
+ * Function definitions and documentation are in metricsRegistry.cpp.
+ *
+ */
+class MetricsRegistry {
+public:
+    MetricsRegistry() {}
+
+    MetricsRegistry(const MetricsRegistry& other) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry& other) = delete;
+
+    MetricCounter& counter(std::string const& name, std::string const& help = "");
+    MetricGauge& gauge(std::string const& name, std::string const& help = "");
+    MetricHistogram& histogram(std::string const& name, std::string const& help = "", std::vector<double> const& bounds = std::vector<double>());
+
+    void writePrometheus(std::ostream& out) const;
+    json toJson() const;
+
+private:
+    template <typename T>
+    T* find(std::string const& name);
+
+    mutable std::mutex mtx;
+    std::vector<std::unique_ptr<Metric>> metrics;       // In registration order, which is the export order
+    std::map<std::string, Metric*> metricsByName;
+};
+
+
+/**
+ * @brief Metrics shared by ATS and SimulatedATS, registered once in metricsRegistry.cpp so both acquisition paths report under the same names.
+ *
+ */
+struct AcquisitionMetrics {
+    MetricCounter& buffers;
+    MetricCounter& samples;     // Per channel
+    MetricCounter& failures;
+    MetricGauge& dutyCycle;
+    MetricGauge& sampleRate;
+
+    void recordAcquisition(double samplesPerBuffer, double rate, unsigned long long buffersCompleted, double acquisitionTime);
+};
+
+
+/**
+ * @brief Writes a MetricsRegistry to a file every interval from its own thread, and once more on stop(). METRICS_PROMETHEUS replaces the file
+ * each time (written to a temporary file and renamed, so a reader never sees half of it). METRICS_JSON_LINES appends one line per export with
+ * the wall clock time, so the file keeps the history. Function definitions and documentation are in metricsRegistry.cpp.
+ *
+ */
+class MetricsExporter {
+public:
+    MetricsExporter();
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter& other) = delete;
+    MetricsExporter& operator=(const MetricsExporter& other) = delete;
+
+    void start(MetricsRegistry& registry, std::string const& filename, int format = METRICS_PROMETHEUS, double interval = METRICS_EXPORT_INTERVAL);
+    void stop();
+    void exportNow();
+
+    bool isRunning() const { return exportThread.joinable(); }
+
+private:
+    void exportPeriodically();
+
+    MetricsRegistry* registry;
+    std::string filename;
+    int format;
+    double interval;
+
+    std::thread exportThread;
+    std::mutex mtx;
+    std::condition_variable wake;
+    bool stopRequested;
+};
+
+#endif // METRICS_REGISTRY_H
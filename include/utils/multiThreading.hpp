@@ -86,3 +86,319 @@ public:
         return dataQueue.size();
     }
 };
+
+
+
+/**
+ * @brief Bounded single producer/single consumer ring for passing data between pipeline stages. Same push/pushFinal/waitAndPop interface as
+ * ThreadSafeQueue, but elements are moved into preallocated slots and the hot path is a few atomic loads and stores with no lock and no
+ * allocation. The producer and consumer indices live on separate cache lines.
+ *
+ * @details Each slot carries a sequence number: slot i is free for the push at position t when its sequence is t, and holds the element at
+ * position h when its sequence is h + 1. The consumer claims an element by advancing head with a CAS, which lets a QUEUE_DROP_OLDEST
+ * producer evict the oldest element with the same CAS when the ring is full.
+ *
+ * Waiting is adaptive: a blocked side spins for SPSC_SPIN_COUNT checks, yields for SPSC_YIELD_COUNT more, then sleeps on a condition
+ * variable. The other side only touches the mutex when it sees the waiting flag set, so an uncontended handoff never locks.
+ *
+ * isInputComplete() becomes true once the consumer has popped the element pushed with pushFinal, so the usual
+ * "if (isInputComplete() && empty())" check right after a pop is exact.
+ *
+ * @warning Exactly one thread may push and exactly one thread may pop.
+ */
+template<typename T>
+class SPSCQueue {
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        bool isFinal;
+        T value;
+    };
+
+    // Producer side
+    std::atomic<size_t> tail;
+    std::atomic<bool> producerWaiting;
+    char producerPad[CACHE_LINE_SIZE];
+
+    // Consumer side
+    std::atomic<size_t> head;
+    std::atomic<bool> consumerWaiting;
+    std::atomic<bool> finalPopped;
+    char consumerPad[CACHE_LINE_SIZE];
+
+    // Shared, read only after construction
+    size_t capacity;
+    size_t mask;
+    int fullPolicy;
+    std::atomic<bool>* overflowFlag;
+    std::unique_ptr<Slot[]> slots;
+
+    // Only used once a side decides to sleep
+    std::mutex mtx;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    // Producer owns everything but popWaitTime, which the consumer owns. Read once both sides are done
+    QueueStats stats;
+
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    // Spin, then yield, then sleep until ready() is true. waiting is the flag the other side checks before notifying
+    template<typename Predicate>
+    void waitFor(Predicate ready, std::atomic<bool>& waiting, std::condition_variable& cond) {
+        for (int i = 0; i < SPSC_SPIN_COUNT + SPSC_YIELD_COUNT; i++) {
+            if (ready()) return;
+            if (i >= SPSC_SPIN_COUNT) std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(mtx);
+        waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lock, ready);
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    void wake(std::atomic<bool>& waiting, std::condition_variable& cond) {
+        // Pairs with the fence in waitFor so a side going to sleep either sees the update or gets notified
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mtx);
+            cond.notify_one();
+        }
+    }
+
+    void publish(T&& newValue, bool isFinal) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        Slot& slot = slots[t & mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != t) {
+            // Full: the slot still holds the element at t - capacity
+            stats.overflows++;
+
+            if (fullPolicy == QUEUE_DROP_OLDEST) {
+                size_t oldest = t - capacity;
+                if (head.compare_exchange_strong(oldest, oldest + 1, std::memory_order_acq_rel)) {
+                    // Evicted, this thread now owns the slot. Overwriting the element releases anything it holds (e.g. a pool block)
+                    slot.value = T();
+                    slot.sequence.store(t, std::memory_order_relaxed);
+                    stats.drops++;
+                }
+            }
+            else if (fullPolicy == QUEUE_FLAG_OVERFLOW && overflowFlag) {
+                overflowFlag->store(true);
+            }
+
+            // Block, or the consumer claimed the oldest element first and is still moving it out
+            if (slot.sequence.load(std::memory_order_acquire) != t) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                waitFor([&slot, t]{ return slot.sequence.load(std::memory_order_acquire) == t; }, producerWaiting, notFull);
+                stats.pushBlockedTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+
+        slot.value = std::move(newValue);
+        slot.isFinal = isFinal;
+        slot.sequence.store(t + 1, std::memory_order_release);
+        tail.store(t + 1, std::memory_order_release);
+
+        stats.pushed++;
+        size_t depth = t + 1 - head.load(std::memory_order_relaxed);
+        if (depth > stats.maxDepth) stats.maxDepth = depth;
+
+        wake(consumerWaiting, notEmpty);
+    }
+
+    bool popReady() const {
+        size_t h = head.load(std::memory_order_acquire);
+        return slots[h & mask].sequence.load(std::memory_order_acquire) == h + 1;
+    }
+
+    bool tryClaim(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+
+        while (true) {
+            Slot& slot = slots[h & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != h + 1) {
+                return false;
+            }
+
+            // Only fails if the producer evicted this element, in which case h is reloaded and the next one is tried
+            if (head.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                value = std::move(slot.value);
+                if (slot.isFinal) {
+                    finalPopped.store(true, std::memory_order_relaxed);
+                }
+                slot.sequence.store(h + capacity, std::memory_order_release);
+
+                wake(producerWaiting, notFull);
+                return true;
+            }
+        }
+    }
+
+public:
+    /**
+     * @param requestedCapacity - number of slots, rounded up to a power of 2
+     * @param fullPolicy - QUEUE_BLOCK, QUEUE_DROP_OLDEST or QUEUE_FLAG_OVERFLOW, what push does when the ring is full
+     * @param overflowFlag - set when a QUEUE_FLAG_OVERFLOW queue fills up
+     */
+    explicit SPSCQueue(size_t requestedCapacity = PIPELINE_QUEUE_CAPACITY, int fullPolicy = QUEUE_BLOCK, std::atomic<bool>* overflowFlag = nullptr) 
+        : tail(0), producerWaiting(false), head(0), consumerWaiting(false), finalPopped(false), fullPolicy(fullPolicy), overflowFlag(overflowFlag)
+    {
+        capacity = roundUpPow2(requestedCapacity > 1 ? requestedCapacity : 2);
+        mask = capacity - 1;
+
+        slots.reset(new Slot[capacity]);
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+            slots[i].isFinal = false;
+        }
+
+        stats = QueueStats();
+        stats.capacity = capacity;
+    }
+
+    // Prevent Queue copies
+    SPSCQueue(const SPSCQueue& other) = delete;
+    SPSCQueue& operator=(const SPSCQueue& other) = delete;
+
+    void push(T newValue) {
+        publish(std::move(newValue), false);
+    }
+
+    void pushFinal(T newValue) {
+        publish(std::move(newValue), true);
+    }
+
+    bool tryPop(T& value) {
+        return tryClaim(value);
+    }
+
+    void waitAndPop(T& value) {
+        if (tryClaim(value)) {
+            return;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (true) {
+            waitFor([this]{ return popReady(); }, consumerWaiting, notEmpty);
+
+            // Can still fail if the producer evicted the element between the check and the claim
+            if (tryClaim(value)) {
+                break;
+            }
+        }
+        stats.popWaitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool isInputComplete() const {
+        return finalPopped.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    // Only meaningful once the producer and consumer threads are done
+    QueueStats getStats() const {
+        return stats;
+    }
+};
+
+
+// Queue used between pipeline stages. Every link has exactly one producer and one consumer
+template<typename T>
+using PipelineQueue = SPSCQueue<T>;
+
+
+
+/**
+ * @brief A set of SPSC lanes used to fan one producer out to several parallel workers and back into one consumer in order. Element k of the
+ * stream goes to lane k % numLanes, so a worker per lane sees its share in order and a consumer that pops the lanes round robin gets the
+ * whole stream back in sequence without a reorder buffer.
+ *
+ * @details pushFinal puts the final element in its lane and an empty T() final in every other lane so each worker terminates. The round
+ * robin consumer stops at the real final and never reaches those sentinels. pushFinalEmpty ends every lane with T(), for an unexpected exit.
+ *
+ */
+template<typename T>
+class LanedQueue {
+private:
+    std::vector<std::unique_ptr<SPSCQueue<T>>> lanes;
+
+public:
+    /**
+     * @param numLanes - number of lanes, one per worker
+     * @param totalCapacity - capacity shared out between the lanes
+     * @param fullPolicy - QUEUE_* policy of every lane
+     * @param overflowFlag - set when a QUEUE_FLAG_OVERFLOW lane fills up
+     */
+    LanedQueue(int numLanes, size_t totalCapacity = PIPELINE_QUEUE_CAPACITY, int fullPolicy = QUEUE_BLOCK, std::atomic<bool>* overflowFlag = nullptr) {
+        numLanes = numLanes > 1 ? numLanes : 1;
+        size_t laneCapacity = totalCapacity/numLanes > 2 ? totalCapacity/numLanes : 2;
+
+        for (int i = 0; i < numLanes; i++) {
+            lanes.emplace_back(new SPSCQueue<T>(laneCapacity, fullPolicy, overflowFlag));
+        }
+    }
+
+    // Prevent Queue copies
+    LanedQueue(const LanedQueue& other) = delete;
+    LanedQueue& operator=(const LanedQueue& other) = delete;
+
+    int numLanes() const {
+        return (int)lanes.size();
+    }
+
+    SPSCQueue<T>& lane(size_t sequence) {
+        return *lanes[sequence % lanes.size()];
+    }
+
+    void push(size_t sequence, T newValue) {
+        lane(sequence).push(std::move(newValue));
+    }
+
+    void pushFinal(size_t sequence, T newValue) {
+        for (size_t i = 1; i < lanes.size(); i++) {
+            lane(sequence + i).pushFinal(T());
+        }
+        lane(sequence).pushFinal(std::move(newValue));
+    }
+
+    void pushFinalEmpty() {
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lanes[i]->pushFinal(T());
+        }
+    }
+
+    // Counters summed over the lanes. Capacity and max depth are per lane (the deepest lane)
+    QueueStats getStats() const {
+        QueueStats total = lanes[0]->getStats();
+
+        for (size_t i = 1; i < lanes.size(); i++) {
+            QueueStats stats = lanes[i]->getStats();
+
+            total.pushed += stats.pushed;
+            total.maxDepth = (stats.maxDepth > total.maxDepth) ? stats.maxDepth : total.maxDepth;
+            total.overflows += stats.overflows;
+            total.drops += stats.drops;
+            total.pushBlockedTime += stats.pushBlockedTime;
+            total.popWaitTime += stats.popWaitTime;
+        }
+        return total;
+    }
+};
@@ -0,0 +1,109 @@
+/**
+ * @file rawStream.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definitions for RawStreamRecorder and RawStreamReplay. The recorder streams raw U16 DMA buffers to disk from the acquisition
+ *        thread through a dedicated writer thread. The replay side memory maps such a file so SimulatedATS can feed the recorded samples back
+ *        through the pipeline. Replay needs neither Windows nor the card, so a recording from the acquisition host plays back on a Linux
+ *        build with SIMULATED_ATS (cpp_test, cpp_pipeline_bench).
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef RAW_STREAM_H
+#define RAW_STREAM_H
+
+#include "decs.hpp"
+
+#define RAW_STREAM_MAGIC    "ATSRAW01"
+#define RAW_STREAM_VERSION  (1)
+
+/**
+ * @brief Fixed 64 byte header at the start of a raw stream file. It is followed by bufferCount buffers of channelCount*samplesPerBuffer codes
+ * each, laid out exactly like the ATS9462 DMA buffers (all of channel A followed by all of channel B). Fields are fixed width so the
+ * layout doesn't depend on the size of long.
+ *
+ */
+struct RawStreamHeader {
+    char magic[8];              // RAW_STREAM_MAGIC, not null terminated
+    std::uint32_t version;      // RAW_STREAM_VERSION
+    std::uint32_t channelCount;
+    std::uint32_t samplesPerBuffer;     // Per channel
+    std::uint32_t bytesPerSample;
+    double sampleRate;          // Hz
+    double inputRange;          // Full scale range (V)
+    std::uint64_t bufferCount;  // 0 if the recording was not closed, in which case the file size is used
+    char reserved[16];
+};
+
+
+/**
+ * @brief Writes raw DMA buffers to a file without holding up the acquisition. record() copies the buffer into a recycled block and hands it to
+ * the writer thread through an SPSCQueue, so only the acquisition thread may call it. The queue blocks when the disk falls behind, which
+ * shows up as a board overflow rather than a silently incomplete file. Function definitions and documentation are in rawStream.cpp.
+ *
+ */
+class RawStreamRecorder {
+public:
+    RawStreamRecorder();
+    ~RawStreamRecorder();
+
+    RawStreamRecorder(const RawStreamRecorder& other) = delete;
+    RawStreamRecorder& operator=(const RawStreamRecorder& other) = delete;
+
+    void start(std::string const& filename, AcquisitionParameters const& acquisitionParams, int queueCapacity = RAW_RECORDER_QUEUE_CAPACITY);
+    void record(const void* dmaBuffer);
+    void stop();
+
+    bool isRecording() const { return writerThread.joinable(); }
+
+private:
+    void writeBuffers();
+
+    std::FILE* file;
+    std::string filename;
+    RawStreamHeader header;
+    size_t bufferSamples;
+
+    std::unique_ptr<SPSCQueue<std::vector<U16>>> writeQueue;
+    std::unique_ptr<SPSCQueue<std::vector<U16>>> recycleQueue;
+    std::thread writerThread;
+
+    unsigned long long buffersWritten;
+    std::atomic<bool> writeFailed;
+};
+
+
+/**
+ * @brief Read only memory map of a raw stream file. Buffers are returned as pointers into the mapping, so replay does not copy them. Function
+ * definitions and documentation are in rawStream.cpp.
+ *
+ */
+class RawStreamReplay {
+public:
+    RawStreamReplay();
+    ~RawStreamReplay();
+
+    RawStreamReplay(const RawStreamReplay& other) = delete;
+    RawStreamReplay& operator=(const RawStreamReplay& other) = delete;
+
+    void open(std::string const& filename);
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    std::string const& getFilename() const { return filename; }
+    RawStreamHeader const& getHeader() const { return header; }
+    unsigned long long getBufferCount() const { return header.bufferCount; }
+
+    const U16* buffer(unsigned long long index) const;
+
+private:
+    std::string filename;
+    RawStreamHeader header;
+
+    MappedFile file;
+};
+
+#endif // RAW_STREAM_H
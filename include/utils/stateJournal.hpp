@@ -0,0 +1,103 @@
+/**
+ * @file stateJournal.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definition for StateJournal, the binary store of the exclusion state in the state path. Each saveState appends a record of the
+ *        bins of the active window that changed since the last one to state.journal, and every JOURNAL_SNAPSHOT_INTERVAL saves the window is
+ *        compacted into state.snapshot and the journal starts over. Bins that leave the window are final and are appended to state.segment.
+ *        Resuming maps the snapshot and journal and replays the journal on top of the snapshot, the segment is only read to plot the whole
+ *        exclusion line.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef STATE_JOURNAL_H
+#define STATE_JOURNAL_H
+
+#include "decs.hpp"
+
+#define STATE_JOURNAL_FILE      "state.journal"
+#define STATE_SNAPSHOT_FILE     "state.snapshot"
+#define STATE_SEGMENT_FILE      "state.segment"
+#define STATE_JOURNAL_MAGIC     "EXJRNL01"
+#define STATE_SNAPSHOT_MAGIC    "EXSNAP01"
+#define STATE_SEGMENT_MAGIC     "EXSEGM01"
+#define STATE_JOURNAL_VERSION   (2)
+
+struct StateSnapshot;
+
+/**
+ * @brief 16 byte header at the start of state.journal, state.snapshot and state.segment. In state.segment it is followed by a power and a
+ * frequency (doubles) per finalized bin, in bin order.
+ *
+ */
+struct StateFileHeader {
+    char magic[8];              // STATE_JOURNAL_MAGIC, STATE_SNAPSHOT_MAGIC or STATE_SEGMENT_MAGIC, not null terminated
+    std::uint32_t version;      // STATE_JOURNAL_VERSION
+    std::uint32_t reserved;
+};
+
+
+/**
+ * @brief Fixed 80 byte header of one record. It is followed by binCount powers, binCount frequencies, binCount coeffSumA and binCount
+ * coeffSumB values (doubles) for bins [firstBin, firstBin + binCount). The window starts at baseIndex, bins below it are in the segment
+ * file. A record with firstBin equal to baseIndex holds the whole window. The snapshot file holds one such record, the journal any number.
+ * A record that is cut short or fails its CRC ends the file, which is what a crash part way through an append leaves behind.
+ *
+ */
+struct StateRecordHeader {
+    std::uint32_t crc;          // CRC-32 of the rest of the header and the bins
+    std::uint32_t binCount;
+    std::uint64_t sequence;     // Increases by one per record across the journal and snapshots of a state path
+    std::uint64_t firstBin;
+    std::uint64_t totalBins;    // Length of the exclusion line after the record is applied
+    std::uint64_t baseIndex;    // First bin of the window, and the number of bins in the segment file
+    std::int64_t startIndex;
+    std::int64_t cutoffIndex;
+    double freqRes;
+    double trueCenterFreq;      // MHz, previousCenterFreq of scanInfo.json
+    std::uint64_t reserved;
+};
+
+
+/**
+ * @brief Writes the exclusion state of one state path, see the file description. Every record and the finalized bins before it are flushed to
+ * disk before append() returns, so a crash loses at most the step being written. Only one thread may use a journal. Function definitions and documentation are in
+ * stateJournal.cpp.
+ *
+ */
+class StateJournal {
+public:
+    StateJournal();
+    ~StateJournal();
+
+    StateJournal(const StateJournal& other) = delete;
+    StateJournal& operator=(const StateJournal& other) = delete;
+
+    void open(std::string const& statePath);
+    void append(StateSnapshot const& snapshot);
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+    std::string const& getStatePath() const { return statePath; }
+
+    static bool exists(std::string const& statePath);
+    static StateSnapshot load(std::string const& statePath);
+    static Spectrum loadFinalized(std::string const& statePath, size_t bins);
+
+private:
+    void openSegment(size_t finalizedBins);
+    void appendFinalized(StateSnapshot const& snapshot);
+    void appendRecord(StateSnapshot const& snapshot);
+    void writeSnapshot(StateSnapshot const& snapshot);
+
+    std::FILE* file;            // state.journal
+    std::FILE* segmentFile;     // state.segment
+    std::string statePath;
+    std::uint64_t nextSequence;
+    std::uint64_t segmentBins;  // Finalized bins in state.segment
+};
+
+#endif // STATE_JOURNAL_H
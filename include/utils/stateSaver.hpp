@@ -0,0 +1,119 @@
+/**
+ * @file stateSaver.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definition for StateSaver and the snapshots it writes. ScanRunner copies the scan state it wants saved into a snapshot and
+ *        hands it to the saver's writer thread, so the journal, CSV and json writes of saveState and saveData happen off the scan thread.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef STATE_SAVER_H
+#define STATE_SAVER_H
+
+#include "decs.hpp"
+
+/**
+ * @brief Copy of the exclusion state written by ScanRunner::saveState. The vectors only hold bins [firstBin, totalBins), the bins of the
+ * active window that changed since the last save, and finalizedBins the bins that left the window since then.
+ *
+ */
+struct StateSnapshot {
+    Spectrum exclusionLine;
+    std::vector<double> coeffSumA;
+    std::vector<double> coeffSumB;
+    Spectrum finalizedBins;     // Bins [baseIndex - size, baseIndex)
+
+    size_t firstBin = 0;
+    size_t totalBins = 0;       // Length of the full exclusion line
+    size_t baseIndex = 0;       // First bin of the active window
+    bool compact = false;       // Holds the whole window, write it as the journal's new snapshot
+
+    double freqRes = 0;
+    int startIndex = 0;
+    int cutoffIndex = 0;
+    double trueCenterFreq = 0;  // Saved as previousCenterFreq
+
+    std::string statePath;
+    std::string prefix;         // Prepended to scanInfo.json
+    int precision = 9;
+};
+
+
+/**
+ * @brief Copy of the step results written by ScanRunner::saveData. The baseline, frequency axis and outliers are worked out by the writer
+ * thread.
+ *
+ */
+struct DataSnapshot {
+    std::vector<double> runningAverage;
+    Dsp::Params baselineFilter;         // Of the step's DataProcessor, to work the baseline out from the running average
+    Spectrum exclusionLine;             // From bin segmentBins on
+    std::vector<int> acquiredSpectra;   // ACQUIRED_SPECTRA metric
+
+    std::string statePath;
+    size_t segmentBins = 0;     // Leading bins of the exclusion line to read back from the state journal's segment file
+
+    size_t samplesPerBuffer = 0;
+    double sampleRate = 0;      // Hz
+
+    std::string savePath;
+    std::string timestamp;      // getDateTimeString() when the snapshot was taken, names the per step files
+    bool decisionMaking = false;
+};
+
+
+/**
+ * @brief One queued write. Exactly one of the snapshots is set, a job with neither ends the writer thread.
+ *
+ */
+struct SaveJob {
+    std::unique_ptr<StateSnapshot> state;
+    std::unique_ptr<DataSnapshot> data;
+};
+
+
+/**
+ * @brief Writes snapshots in the order they were submitted on a dedicated thread. Only the thread that owns the saver may submit. The queue
+ * blocks when the disk falls behind so memory stays bounded. Time spent writing goes to TIMER_SAVE and the queue depth at every submit to the
+ * SAVE_QUEUE_DEPTH metric. Function definitions and documentation are in stateSaver.cpp.
+ *
+ */
+class StateSaver {
+public:
+    StateSaver();
+    ~StateSaver();
+
+    StateSaver(const StateSaver& other) = delete;
+    StateSaver& operator=(const StateSaver& other) = delete;
+
+    void start(int queueCapacity = SAVE_QUEUE_CAPACITY);
+    void submit(StateSnapshot&& snapshot);
+    void submit(DataSnapshot&& snapshot);
+    void flush();
+    void stop();
+
+    bool isRunning() const { return writerThread.joinable(); }
+
+private:
+    void submitJob(SaveJob&& job);
+    void writeJobs();
+
+    void writeState(StateSnapshot const& snapshot);
+    static void writeData(DataSnapshot& snapshot);
+
+    StateJournal journal;       // Only touched by the thread that writes
+
+    std::unique_ptr<SPSCQueue<SaveJob>> jobQueue;
+    std::thread writerThread;
+
+    // Submitted and written job counts, for flush()
+    std::mutex mtx;
+    std::condition_variable jobWritten;
+    unsigned long long jobsSubmitted;
+    unsigned long long jobsWritten;
+};
+
+#endif // STATE_SAVER_H
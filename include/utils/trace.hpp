@@ -0,0 +1,67 @@
+/**
+ * @file trace.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definition for TraceBuffer and the TraceEvent it stores. Every pipeline stage records when it receives and finishes each block
+ *        or spectrum, tagged with the DMA buffers it came from, so the latency from the board to the decision can be measured per spectrum
+ *        instead of estimated from spectrum counts.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "decs.hpp"
+
+/**
+ * @brief One trace record. Times are traceClock() nanoseconds. 40 bytes, so a million events is 40 MB.
+ *
+ */
+struct TraceEvent {
+    std::int64_t time;
+    std::int64_t acquiredTime;      // From the tag, when the last buffer of the range was acquired
+    std::uint64_t firstBuffer;      // Buffers [firstBuffer, firstBuffer + bufferCount) of acquisition step
+    std::uint32_t bufferCount;
+    std::int32_t step;
+    std::uint8_t stage;             // TRACE_ACQUISITION ... TRACE_DECISION
+    std::uint8_t kind;              // TRACE_ENQUEUE, TRACE_DEQUEUE or TRACE_FINISH
+    std::uint16_t thread;           // Small per-process thread number, in order of the threads' first event
+};
+
+
+/**
+ * @brief Fixed capacity event log that any number of threads can record into without locking. Each record claims the next slot with one
+ * atomic increment, writes it and marks it ready. Once every slot is taken further events are counted as dropped rather than overwriting
+ * the start of the trace. Function definitions and documentation are in trace.cpp.
+ *
+ * @warning reset() must not run while other threads are recording.
+ *
+ */
+class TraceBuffer {
+public:
+    TraceBuffer();
+
+    TraceBuffer(const TraceBuffer& other) = delete;
+    TraceBuffer& operator=(const TraceBuffer& other) = delete;
+
+    void reset(size_t capacity);
+    void record(TraceEvent const& event);
+
+    std::vector<TraceEvent> events() const;
+
+    size_t getCapacity() const { return capacity; }
+    size_t dropped() const { return droppedEvents.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<TraceEvent[]> slots;
+    std::unique_ptr<std::atomic<bool>[]> ready;
+    size_t capacity;
+
+    std::atomic<size_t> nextSlot;
+    std::atomic<size_t> droppedEvents;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,103 @@
+/**
+ * @file workerPool.hpp
+ * @author your name (you@domain.com)
+ * @brief Class definitions for PipelineWorker and WorkerPool. The pipeline stages run on persistent worker threads that are handed a new task
+ *        every step instead of being spawned and joined per acquisition. Each worker role has its own CPU affinity and priority, so the
+ *        acquisition thread can be kept apart from the analysis threads.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "decs.hpp"
+
+/**
+ * @brief Scheduling settings of a worker. An affinity mask of 0 lets the worker run on any CPU of the process.
+ *
+ */
+struct WorkerSettings {
+    unsigned long long affinityMask = 0;        // Bit n = logical CPU n
+    int priority = WORKER_PRIORITY_NORMAL;      // WORKER_PRIORITY_*
+};
+
+
+/**
+ * @brief One persistent thread that runs one task at a time. run() hands it a task and returns immediately, wait() blocks until the task is
+ * done. Settings are applied on the worker itself before the task starts, and only when they change. Function definitions and documentation
+ * are in workerPool.cpp.
+ *
+ */
+class PipelineWorker {
+public:
+    PipelineWorker();
+    ~PipelineWorker();
+
+    PipelineWorker(const PipelineWorker& other) = delete;
+    PipelineWorker& operator=(const PipelineWorker& other) = delete;
+
+    void run(std::function<void()> task, WorkerSettings const& settings);
+    void wait();
+
+    bool isBusy() const;
+
+private:
+    void workerLoop();
+    void applySettings(WorkerSettings const& settings);
+
+    mutable std::mutex mtx;
+    std::condition_variable taskPosted;
+    std::condition_variable taskDone;
+
+    std::function<void()> task;
+    WorkerSettings pendingSettings;
+    WorkerSettings appliedSettings;
+    bool busy;
+    bool shutdown;
+
+    std::thread thread;
+};
+
+
+/**
+ * @brief Persistent workers grouped by WORKER_* role. run() gives a task to an idle worker of the role, creating one the first time the role
+ * needs more workers than it has. Only the thread that owns the pool may call run() and wait(). Function definitions and documentation are in
+ * workerPool.cpp.
+ *
+ */
+class WorkerPool {
+public:
+    WorkerPool() = default;
+
+    WorkerPool(const WorkerPool& other) = delete;
+    WorkerPool& operator=(const WorkerPool& other) = delete;
+
+    void setRoleSettings(int role, WorkerSettings const& settings);
+
+    /**
+     * @brief Runs f(args...) on a worker of role. Arguments are bound like std::thread binds them, so pass std::ref for references.
+     *
+     * @param role - WORKER_* role of the task
+     * @param f - Function to run
+     * @param args - Arguments of f
+     */
+    template <typename F, typename... Args>
+    void run(int role, F&& f, Args&&... args) {
+        runTask(role, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+
+    void wait(int role);
+    void waitAll();
+
+private:
+    void runTask(int role, std::function<void()> task);
+
+    WorkerSettings roleSettings[NUM_WORKER_ROLES];
+    std::vector<std::unique_ptr<PipelineWorker>> workers[NUM_WORKER_ROLES];
+};
+
+#endif // WORKER_POOL_H
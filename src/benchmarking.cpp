@@ -0,0 +1,401 @@
+/**
+ * @file benchmarking.cpp
+ * @author your name (you@domain.com)
+ * @brief Standalone microbenchmarks for the hot loops of the acquisition pipeline. Built as cpp_bench, needs no hardware.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+void conversionBenchmark(U32 samplesPerBuffer, int repetitions);
+void legacyConversion(const U16* samplesA, const U16* samplesB, fftw_complex* output, U32 numSamples, double inputRange);
+void queueBenchmark(int items);
+template<typename Queue> double timeHandoff(Queue& queue, int items);
+void precisionComparison(int samplesPerBuffer, int numSpectra, int subSpectraAveragingNumber);
+std::vector<double> exclusionLineFromRaw(const std::vector<std::vector<double>>& rawSpectra, const std::vector<double>& baseline, double sampleRate);
+void exclusionBenchmark(int numBins, int repetitions);
+void legacyUpdateExclusionLine(BayesFactors& bayesFactors, CombinedSpectrum combinedSpectrum);
+
+int main() {
+    // Same geometry as a 32 MS/s, 100 Hz RBW acquisition
+    conversionBenchmark(320000, 500);
+    queueBenchmark(2000000);
+    precisionComparison(320000, 400, 20);
+
+    // Rebinned combined spectra of a 4096 point, a 32768 point and a 32 MS/s, 100 Hz RBW acquisition
+    exclusionBenchmark(330, 20000);
+    exclusionBenchmark(2600, 2000);
+    exclusionBenchmark(25600, 200);
+}
+
+
+
+/**
+ * @brief Times convertSamplesToComplex against the original per-sample conversion loop on one buffer of random codes, and checks that the
+ * two agree.
+ *
+ * @param samplesPerBuffer - samples per channel in the buffer
+ * @param repetitions - number of times each conversion is run
+ */
+void conversionBenchmark(U32 samplesPerBuffer, int repetitions) {
+    double inputRange = 0.8;
+
+    std::vector<U16> buffer(2*samplesPerBuffer);
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> codes(0, 0xFFFF);
+    for (U16& code : buffer) {
+        code = (U16)codes(generator);
+    }
+    const U16* samplesA = buffer.data();
+    const U16* samplesB = buffer.data() + samplesPerBuffer;
+
+    fftw_complex* legacyOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * samplesPerBuffer));
+    fftw_complex* kernelOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * samplesPerBuffer));
+
+    // Warm up caches and page in the outputs
+    legacyConversion(samplesA, samplesB, legacyOutput, samplesPerBuffer, inputRange);
+    convertSamplesToComplex(samplesA, samplesB, kernelOutput, samplesPerBuffer, inputRange, 0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        legacyConversion(samplesA, samplesB, legacyOutput, samplesPerBuffer, inputRange);
+    }
+    std::chrono::duration<double> legacyTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        convertSamplesToComplex(samplesA, samplesB, kernelOutput, samplesPerBuffer, inputRange, 0);
+    }
+    std::chrono::duration<double> kernelTime = std::chrono::steady_clock::now() - start;
+
+    double maxError = 0;
+    for (U32 i = 0; i < samplesPerBuffer; i++) {
+        for (int j = 0; j < 2; j++) {
+            double error = std::abs(legacyOutput[i][j] - kernelOutput[i][j]);
+            maxError = (error > maxError) ? error : maxError;
+        }
+    }
+
+    double samples = (double)samplesPerBuffer*repetitions;
+    std::cout << "Sample conversion, " << samplesPerBuffer << " samples per buffer, " << repetitions << " buffers" << std::endl;
+    std::cout << "  Legacy loop: " << legacyTime.count()/repetitions*1e6 << " us per buffer (" << samples/legacyTime.count()/1e6 << " MS/s)" << std::endl;
+    std::cout << "  Kernel:      " << kernelTime.count()/repetitions*1e6 << " us per buffer (" << samples/kernelTime.count()/1e6 << " MS/s)" << std::endl;
+    std::cout << "  Speedup:     " << legacyTime.count()/kernelTime.count() << "x, max abs difference " << maxError << " V" << std::endl;
+
+    fftw_free(legacyOutput);
+    fftw_free(kernelOutput);
+}
+
+
+
+/**
+ * @brief The per-sample conversion loop from ATS::AcquireDataMultithreadedContinuous before it was vectorized, kept as the reference.
+ *
+ */
+void legacyConversion(const U16* samplesA, const U16* samplesB, fftw_complex* output, U32 numSamples, double inputRange) {
+    for (unsigned int i=0; i < numSamples; i++) {
+        output[i][0] = (samplesA[i] / (double)0xFFFF) * 2 * inputRange - inputRange;
+        output[i][1] = (samplesB[i] / (double)0xFFFF) * 2 * inputRange - inputRange;
+
+        // Trick to 0-center the dft
+        if (i % 2 == 1) {
+            output[i][0] *= -1;
+            output[i][1] *= -1;
+        }
+    }
+}
+
+
+
+/**
+ * @brief Measures the per-item handoff cost between two threads for ThreadSafeQueue and SPSCQueue. The producer pushes items as fast as it
+ * can and the consumer pops them with the same waitAndPop/isInputComplete loop the pipeline threads use.
+ *
+ * @param items - number of items passed through each queue
+ */
+void queueBenchmark(int items) {
+    ThreadSafeQueue<size_t> lockedQueue;
+    SPSCQueue<size_t> ringQueue(PIPELINE_QUEUE_CAPACITY);
+
+    double lockedTime = timeHandoff(lockedQueue, items);
+    double ringTime = timeHandoff(ringQueue, items);
+
+    std::cout << "Queue handoff, " << items << " items" << std::endl;
+    std::cout << "  ThreadSafeQueue: " << lockedTime/items*1e9 << " ns per item" << std::endl;
+    std::cout << "  SPSCQueue:       " << ringTime/items*1e9 << " ns per item (capacity " << ringQueue.getCapacity() << ")" << std::endl;
+}
+
+
+template<typename Queue>
+double timeHandoff(Queue& queue, int items) {
+    size_t checksum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::thread producer([&queue, items]{
+        for (int i = 0; i < items - 1; i++) {
+            queue.push((size_t)i);
+        }
+        queue.pushFinal((size_t)(items - 1));
+    });
+
+    while (true) {
+        size_t value;
+        queue.waitAndPop(value);
+        checksum += value;
+
+        if (queue.isInputComplete() && queue.empty()) {
+            break;
+        }
+    }
+    producer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (checksum != (size_t)items*(items - 1)/2) {
+        std::cout << "  Warning: checksum mismatch, items were lost" << std::endl;
+    }
+    return elapsed.count();
+}
+
+
+
+/**
+ * @brief Runs the same simulated buffers through the double and the float (SINGLE_PRECISION_PIPELINE) versions of conversion, FFT and power,
+ * both summed into a double accumulator as in accumulationThread. Reports the time per buffer of each, and how far apart the averaged raw 
+ * spectra and the resulting 90% exclusion lines end up.
+ *
+ * @param samplesPerBuffer - FFT length
+ * @param numSpectra - number of buffers to run through both paths
+ * @param subSpectraAveragingNumber - buffers per averaged raw spectrum
+ */
+void precisionComparison(int samplesPerBuffer, int numSpectra, int subSpectraAveragingNumber) {
+    int N = samplesPerBuffer;
+    double inputRange = 0.8;
+    double sampleRate = 32e6;
+
+    // Mid scale noise with a weak tone, about what the card sees behind the amplifier chain
+    std::vector<U16> buffer(2*N);
+    std::mt19937 generator(2);
+    std::normal_distribution<double> noise(0, 1500);
+
+    fftw_complex* doubleInput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * N));
+    fftw_complex* doubleOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * N));
+    fftwf_complex* floatInput = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * N));
+    fftwf_complex* floatOutput = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * N));
+
+    fftw_plan doublePlan = fftw_plan_dft_1d(N, doubleInput, doubleOutput, FFTW_FORWARD, FFTW_MEASURE);
+    fftwf_plan floatPlan = fftwf_plan_dft_1d(N, floatInput, floatOutput, FFTW_FORWARD, FFTW_MEASURE);
+
+    std::vector<double> doubleSum(N, 0.0), floatSum(N, 0.0);
+    std::vector<std::vector<double>> doubleSpectra, floatSpectra;
+    std::chrono::duration<double> doubleTime(0), floatTime(0);
+
+    for (int s = 0; s < numSpectra; s++) {
+        for (int i = 0; i < N; i++) {
+            double tone = 300*std::cos(2*M_PI*0.1234*i);
+            double codeA = 0x8000 + tone + noise(generator);
+            double codeB = 0x8000 + noise(generator);
+            buffer[i] = (U16)(codeA < 0 ? 0 : (codeA > 0xFFFF ? 0xFFFF : codeA));
+            buffer[N + i] = (U16)(codeB < 0 ? 0 : (codeB > 0xFFFF ? 0xFFFF : codeB));
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        convertSamplesToComplex(buffer.data(), buffer.data() + N, doubleInput, N, inputRange, 0);
+        fftw_execute(doublePlan);
+        for (int i = 0; i < N; i++) {
+            doubleSum[i] += doubleOutput[i][0]*doubleOutput[i][0] + doubleOutput[i][1]*doubleOutput[i][1];
+        }
+        doubleTime += std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        convertSamplesToComplex(buffer.data(), buffer.data() + N, floatInput, N, inputRange, 0);
+        fftwf_execute(floatPlan);
+        for (int i = 0; i < N; i++) {
+            float power = floatOutput[i][0]*floatOutput[i][0] + floatOutput[i][1]*floatOutput[i][1];
+            floatSum[i] += (double)power;
+        }
+        floatTime += std::chrono::steady_clock::now() - start;
+
+        if ((s + 1) % subSpectraAveragingNumber == 0) {
+            double scale = 1.0 / subSpectraAveragingNumber / N / 50;
+            doubleSpectra.push_back(std::vector<double>(N));
+            floatSpectra.push_back(std::vector<double>(N));
+            for (int i = 0; i < N; i++) {
+                doubleSpectra.back()[i] = doubleSum[i] * scale;
+                floatSpectra.back()[i] = floatSum[i] * scale;
+                doubleSum[i] = 0;
+                floatSum[i] = 0;
+            }
+        }
+    }
+
+    double maxRawError = 0;
+    for (size_t s = 0; s < doubleSpectra.size(); s++) {
+        for (int i = 0; i < N; i++) {
+            double error = std::abs(floatSpectra[s][i] - doubleSpectra[s][i]) / doubleSpectra[s][i];
+            maxRawError = (error > maxRawError) ? error : maxRawError;
+        }
+    }
+
+    // Both paths are processed in double against the same (double) baseline, like a calibration followed by a float scan
+    std::vector<double> baseline = averageVectors(doubleSpectra);
+    std::vector<double> doubleLine = exclusionLineFromRaw(doubleSpectra, baseline, sampleRate);
+    std::vector<double> floatLine = exclusionLineFromRaw(floatSpectra, baseline, sampleRate);
+
+    double maxLineError = 0, sumLineError = 0;
+    int linePoints = 0;
+    for (size_t i = 0; i < doubleLine.size(); i++) {
+        if (doubleLine[i] <= 0) {
+            continue;
+        }
+        double error = std::abs(floatLine[i] - doubleLine[i]) / doubleLine[i];
+        maxLineError = (error > maxLineError) ? error : maxLineError;
+        sumLineError += error*error;
+        linePoints++;
+    }
+
+    std::cout << "Pipeline precision, " << N << " samples per buffer, " << numSpectra << " buffers" << std::endl;
+    std::cout << "  Double conversion+FFT+power: " << doubleTime.count()/numSpectra*1e6 << " us per buffer" << std::endl;
+    std::cout << "  Float conversion+FFT+power:  " << floatTime.count()/numSpectra*1e6 << " us per buffer (" 
+              << doubleTime.count()/floatTime.count() << "x)" << std::endl;
+    std::cout << "  Averaged raw spectra:   max relative difference " << maxRawError << std::endl;
+    std::cout << "  Exclusion line:         max relative difference " << maxLineError << ", rms " 
+              << std::sqrt(sumLineError/(linePoints > 0 ? linePoints : 1)) << " over " << linePoints << " points" << std::endl;
+
+    fftw_destroy_plan(doublePlan);
+    fftwf_destroy_plan(floatPlan);
+    fftw_free(doubleInput);
+    fftw_free(doubleOutput);
+    fftwf_free(floatInput);
+    fftwf_free(floatOutput);
+}
+
+
+/**
+ * @brief Runs averaged raw spectra through the processing and decision chain of processingThread and decisionMakingThread (flat SNR, no bad
+ * bins, no stepping) and returns the 90% exclusion line.
+ *
+ */
+std::vector<double> exclusionLineFromRaw(const std::vector<std::vector<double>>& rawSpectra, const std::vector<double>& baseline, double sampleRate) {
+    int N = (int)baseline.size();
+
+    DataProcessor dataProcessor;
+    dataProcessor.setFilterParams(sampleRate, 3, 10e3, 15);
+    dataProcessor.currentBaseline = baseline;
+    for (int i = 0; i < N; i++) {
+        dataProcessor.SNR.freqAxis.push_back((i - N/2)*sampleRate/N/1e6);
+        dataProcessor.SNR.powers.push_back(1);
+    }
+    dataProcessor.trimmedSNR = dataProcessor.SNR;
+
+    BayesFactors bayesFactors;
+    for (const std::vector<double>& powers : rawSpectra) {
+        Spectrum rawSpectrum;
+        rawSpectrum.powers = powers;
+        dataProcessor.maskBadBinsAndDC(rawSpectrum.powers);
+        rawSpectrum.freqAxis = dataProcessor.SNR.freqAxis;
+        rawSpectrum.trueCenterFreq = 0;
+
+        Spectrum processedSpectrum, processedBaseline;
+        std::tie(processedSpectrum, processedBaseline) = dataProcessor.rawToProcessed(rawSpectrum);
+
+        trimSpectrum(processedSpectrum, 0.1);
+        dataProcessor.trimSNRtoMatch(processedSpectrum);
+
+        Spectrum rescaledSpectrum = dataProcessor.processedToRescaled(processedSpectrum);
+
+        CombinedSpectrum combinedSpectrum;
+        dataProcessor.addRescaledToCombined(rescaledSpectrum, combinedSpectrum);
+
+        bayesFactors.updateExclusionLine(dataProcessor.rebinCombinedSpectrum(combinedSpectrum, 10, 1));
+    }
+
+    return bayesFactors.exclusionLine.powers;
+}
+
+
+
+/**
+ * @brief Times BayesFactors::updateExclusionLine against the original scalar loop on a combined spectrum of numBins bins with the cutoff in
+ * the middle, and checks that the two exclusion states agree.
+ *
+ * @param numBins - length of the rebinned combined spectrum
+ * @param repetitions - number of updates run with each version
+ */
+void exclusionBenchmark(int numBins, int repetitions) {
+    CombinedSpectrum combinedSpectrum;
+    combinedSpectrum.trueCenterFreq = 0;
+    std::mt19937 generator(1);
+    std::normal_distribution<double> noise(0, 1);
+    for (int i = 0; i < numBins; i++) {
+        combinedSpectrum.freqAxis.push_back((i - numBins/2)*1e-4);
+        combinedSpectrum.powers.push_back(noise(generator));
+        combinedSpectrum.weightSum.push_back(1 + i%5);
+        combinedSpectrum.sigmaCombined.push_back(1 + 0.1*std::abs(noise(generator)));
+    }
+
+    // init puts the cutoff in the middle of the first spectrum
+    BayesFactors legacy, kernel;
+    legacy.init(combinedSpectrum);
+    kernel.init(combinedSpectrum);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        legacyUpdateExclusionLine(legacy, combinedSpectrum);
+    }
+    std::chrono::duration<double> legacyTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < repetitions; rep++) {
+        kernel.updateExclusionLine(combinedSpectrum);
+    }
+    std::chrono::duration<double> kernelTime = std::chrono::steady_clock::now() - start;
+
+    double maxError = 0;
+    for (int i = 0; i < numBins; i++) {
+        double error = std::abs(legacy.exclusionLine.powers[i] - kernel.exclusionLine.powers[i]);
+        maxError = (error > maxError) ? error : maxError;
+    }
+
+    std::cout << "Exclusion line update, " << numBins << " bins, " << repetitions << " updates" << std::endl;
+    std::cout << "  Legacy loop: " << legacyTime.count()/repetitions*1e6 << " us per update" << std::endl;
+    std::cout << "  Kernel:      " << kernelTime.count()/repetitions*1e6 << " us per update" << std::endl;
+    std::cout << "  Speedup:     " << legacyTime.count()/kernelTime.count() << "x, max abs difference " << maxError << std::endl;
+}
+
+
+
+/**
+ * @brief BayesFactors::updateExclusionLine before it was vectorized, kept as the reference. Takes the spectrum by value like the original.
+ *
+ */
+void legacyUpdateExclusionLine(BayesFactors& bayesFactors, CombinedSpectrum combinedSpectrum) {
+    double coeffA, coeffB;
+    double scanFactor, newExcludedStrength;
+    double fourLnPtOne = 9.210340372;
+
+    int offset = bayesFactors.startIndex - bayesFactors.baseIndex;
+
+    for(int i=0; i<combinedSpectrum.powers.size(); i++){
+        scanFactor = (1/bayesFactors.sigmaProc)*sqrt(combinedSpectrum.weightSum[i]);
+
+        bayesFactors.coeffSumA[offset+i] += scanFactor*scanFactor/2;
+        bayesFactors.coeffSumB[offset+i] += scanFactor*combinedSpectrum.powers[i]/combinedSpectrum.sigmaCombined[i];
+
+        coeffA = bayesFactors.coeffSumA[offset+i];
+        coeffB = bayesFactors.coeffSumB[offset+i];
+
+        newExcludedStrength = (coeffB+std::sqrt(coeffB*coeffB+fourLnPtOne*coeffA))/(2*coeffA);
+
+        bayesFactors.exclusionLine.powers[offset+i] = newExcludedStrength;
+
+        if(bayesFactors.startIndex + i < bayesFactors.cutoffIndex){
+            bayesFactors.exclusionLine.powers[offset+i] = 0;
+        }
+    }
+}
@@ -49,32 +49,19 @@ void staticRun(ScanParameters scanParameters) {
         scanParameters.dataParameters.trueCenterFreq = 5.0101e3 + scanParameters.dataParameters.stepSize;
         scanParameters.dataParameters.maxIntegrationTime = integrationTime;
         scanParameters.dataParameters.minIntegrationTime = integrationTime;
-        
-        for (int i = 0; i < steps; i++) {
-            ScanRunner scanRunner(scanParameters);
-
-            std::ifstream file(scanParameters.topLevelParameters.statePath + "scanInfo.json");
-            if (file.is_open()) {
-                file.close();
-                scanRunner.loadStateAndStep();
-            }
-            else { file.close(); }
-        
-            scanRunner.acquireData();
-            scanRunner.saveState();
-
-            if (i % 10 == 0){
-                scanRunner.saveData();
-            }
-
-            scanParameters.dataParameters.trueCenterFreq += scanParameters.dataParameters.stepSize;
-
-            std::cout << "Step " << i << " of " << steps << " with integration time " << integrationTime << " complete.\n";
-
-            // if (i == steps - 1) {
-            //     scanRunner.saveState(std::to_string(integrationTime) + "_");
-            // }
+
+        // One runner for the whole scan, the state only comes from disk when resuming
+        ScanRunner scanRunner(scanParameters);
+
+        std::ifstream file(scanParameters.topLevelParameters.statePath + "scanInfo.json");
+        if (file.is_open()) {
+            file.close();
+            scanRunner.loadStateAndStep();
         }
+        else { file.close(); }
+
+        std::cout << "Running " << steps << " steps with integration time " << integrationTime << ".\n";
+        scanRunner.runSteps(steps, scanParameters.dataParameters.stepSize, 10);
 
         std::string jsonString = performanceToJson().dump();
         std::ofstream fileStream(scanParameters.topLevelParameters.savePath + "performances/perf_" + std::to_string(integrationTime) + ".json");
@@ -105,32 +92,20 @@ void dynamicRun(ScanParameters scanParameters) {
 
     // Actual scan
     for (double threshold : thresholds) {
-        for (int i = 0; i < steps; i++) {
-            ScanRunner scanRunner(scanParameters);
-            scanRunner.decisionAgent.threshold = threshold;
-
-            std::ifstream file(scanParameters.topLevelParameters.statePath + "scanInfo.json");
-            if (file.is_open()) {
-                file.close();
-                scanRunner.loadStateAndStep();
-            }
-            else { file.close(); }
-
-            scanRunner.acquireData();
-            // scanRunner.decisionAgent.saveState(scanParameters.topLevelParameters.statePath);
-            scanRunner.saveState();
-
-            if (i % 10 == 0){
-                scanRunner.saveData();
-            }
-
-            scanParameters.dataParameters.trueCenterFreq += scanParameters.dataParameters.stepSize;
-
-            std::cout << "Step " << i << " of " << steps << 
-                      " with max integration time " << scanParameters.dataParameters.maxIntegrationTime << 
-                      " and threshold " << threshold <<
-                      " complete.\n";
+        // One runner for the whole scan, the state only comes from disk when resuming
+        ScanRunner scanRunner(scanParameters);
+        scanRunner.decisionAgent.threshold = threshold;
+
+        std::ifstream file(scanParameters.topLevelParameters.statePath + "scanInfo.json");
+        if (file.is_open()) {
+            file.close();
+            scanRunner.loadStateAndStep();
         }
+        else { file.close(); }
+
+        std::cout << "Running " << steps << " steps with max integration time " << scanParameters.dataParameters.maxIntegrationTime << 
+                  " and threshold " << threshold << ".\n";
+        scanRunner.runSteps(steps, scanParameters.dataParameters.stepSize, 10);
 
         std::string jsonString = performanceToJson().dump();
         std::ofstream fileStream(scanParameters.topLevelParameters.savePath + "performances/perf_" + std::to_string(threshold) + "_dynamic.json");
@@ -1,5 +1,14 @@
 #include "decs.hpp"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BAYES_SSE2
+#include <emmintrin.h>
+#endif
+
+static void updateBins(const double* weightSum, const double* powers, const double* sigmaCombined, double* coeffSumA, double* coeffSumB, 
+                       double* exclusionPowers, int first, int last, double invSigmaProc, bool excluded);
 
 
 /**
@@ -7,7 +16,7 @@
  * 
  * @param combinedSpectrum - first spectrum in the sequence to initialize the exclusion line
  */
-void BayesFactors::init(CombinedSpectrum combinedSpectrum) {
+void BayesFactors::init(CombinedSpectrum const& combinedSpectrum) {
     // Clear any existing data
     exclusionLine.powers.clear();
     exclusionLine.freqAxis.clear();
@@ -30,6 +39,11 @@ void BayesFactors::init(CombinedSpectrum combinedSpectrum) {
     }
 
     cutoffIndex = (int)std::floor(exclusionLine.powers.size()/2);
+    dirtyIndex = 0;
+    baseIndex = 0;
+
+    finalizedBins.powers.clear();
+    finalizedBins.freqAxis.clear();
 }
 
 
@@ -37,46 +51,135 @@ void BayesFactors::init(CombinedSpectrum combinedSpectrum) {
 /**
  * @brief Move the 90% exclusion line to its new coupling strengths based on updated information
  * 
+ * @details Bins below cutoffIndex still collect their coefficients but are excluded at 0. Rather than a branch per bin the spectrum is split 
+ * at the cutoff and each part goes through updateBins in one pass.
+ * 
  * @param combinedSpectrum combinedSpectrum object containing the data to update the exclusion cut with
  */
-void BayesFactors::updateExclusionLine(CombinedSpectrum combinedSpectrum){
+void BayesFactors::updateExclusionLine(CombinedSpectrum const& combinedSpectrum){
     if (coeffSumA.empty()) {
         init(combinedSpectrum);
     }
 
-    double coeffA, coeffB;
-    double scanFactor, newExcludedStrength;
-    double fourLnPtOne = 9.210340372; // Numerical factor 4*ln(0.1) that goes into quadratic formula, 0.1 set by desried exclusion level (90%)
+    dirtyIndex = (startIndex < dirtyIndex) ? startIndex : dirtyIndex;
 
-    for(int i=0; i<combinedSpectrum.powers.size(); i++){
-        scanFactor = (1/sigmaProc)*sqrt(combinedSpectrum.weightSum[i]);
+    // Position of startIndex in the window
+    int offset = startIndex - baseIndex;
+    int numBins = (int)combinedSpectrum.powers.size();
 
-        coeffSumA[startIndex+i] += scanFactor*scanFactor/2;
-        coeffSumB[startIndex+i] += scanFactor*combinedSpectrum.powers[i]/combinedSpectrum.sigmaCombined[i];
+    // Bins [0, split) of the spectrum are below the cutoff
+    int split = cutoffIndex - startIndex;
+    split = (split > 0) ? split : 0;
+    split = (split < numBins) ? split : numBins;
 
-        coeffA = coeffSumA[startIndex+i];
-        coeffB = coeffSumB[startIndex+i];
+    const double* weightSum = combinedSpectrum.weightSum.data();
+    const double* powers = combinedSpectrum.powers.data();
+    const double* sigmaCombined = combinedSpectrum.sigmaCombined.data();
+    double* sumA = coeffSumA.data() + offset;
+    double* sumB = coeffSumB.data() + offset;
+    double* line = exclusionLine.powers.data() + offset;
+
+    updateBins(weightSum, powers, sigmaCombined, sumA, sumB, line, 0, split, 1/sigmaProc, true);
+    updateBins(weightSum, powers, sigmaCombined, sumA, sumB, line, split, numBins, 1/sigmaProc, false);
+}
 
-        newExcludedStrength = (coeffB+std::sqrt(coeffB*coeffB+fourLnPtOne*coeffA))/(2*coeffA);
 
-        exclusionLine.powers[startIndex+i] = newExcludedStrength;
 
-        if(startIndex + i < cutoffIndex){
-            exclusionLine.powers[startIndex+i] = 0;
-        }
+/**
+ * @brief Adds bins [first, last) of a combined spectrum to the coefficient sums and solves the quadratic for their 90% excluded coupling 
+ * strength. Vectorized with AVX2 (four bins at a time) or SSE2 (two at a time), with a scalar loop for the tail. Every path does the same 
+ * IEEE operations in the same order, so the result doesn't depend on the instruction set.
+ * 
+ * @param weightSum, powers, sigmaCombined - Combined spectrum, indexed from its first bin
+ * @param coeffSumA, coeffSumB, exclusionPowers - Exclusion state, indexed from the bin the combined spectrum starts at
+ * @param first, last - Range of bins to update
+ * @param invSigmaProc - 1/sigmaProc
+ * @param excluded - Store 0 instead of the excluded strength (bins below the cutoff)
+ */
+static void updateBins(const double* weightSum, const double* powers, const double* sigmaCombined, double* coeffSumA, double* coeffSumB, 
+                       double* exclusionPowers, int first, int last, double invSigmaProc, bool excluded) {
+    const double fourLnPtOne = 9.210340372; // Numerical factor 4*ln(0.1) that goes into quadratic formula, 0.1 set by desried exclusion level (90%)
+    int i = first;
+
+#if defined(__AVX2__)
+    const __m256d invSigmaVec = _mm256_set1_pd(invSigmaProc);
+    const __m256d factorVec = _mm256_set1_pd(fourLnPtOne);
+    const __m256d halfVec = _mm256_set1_pd(0.5);
+    const __m256d twoVec = _mm256_set1_pd(2.0);
+    // All ones where the strength is kept, zero where it is excluded
+    const __m256d keepMask = excluded ? _mm256_setzero_pd() : _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+    for (; i + 4 <= last; i += 4) {
+        __m256d scanFactor = _mm256_mul_pd(invSigmaVec, _mm256_sqrt_pd(_mm256_loadu_pd(weightSum + i)));
+
+        __m256d coeffA = _mm256_add_pd(_mm256_loadu_pd(coeffSumA + i), _mm256_mul_pd(_mm256_mul_pd(scanFactor, scanFactor), halfVec));
+        __m256d coeffB = _mm256_add_pd(_mm256_loadu_pd(coeffSumB + i), 
+                                       _mm256_div_pd(_mm256_mul_pd(scanFactor, _mm256_loadu_pd(powers + i)), _mm256_loadu_pd(sigmaCombined + i)));
+        _mm256_storeu_pd(coeffSumA + i, coeffA);
+        _mm256_storeu_pd(coeffSumB + i, coeffB);
+
+        __m256d root = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(coeffB, coeffB), _mm256_mul_pd(factorVec, coeffA)));
+        __m256d strength = _mm256_div_pd(_mm256_add_pd(coeffB, root), _mm256_mul_pd(twoVec, coeffA));
+        _mm256_storeu_pd(exclusionPowers + i, _mm256_and_pd(strength, keepMask));
+    }
+#elif defined(BAYES_SSE2)
+    const __m128d invSigmaVec = _mm_set1_pd(invSigmaProc);
+    const __m128d factorVec = _mm_set1_pd(fourLnPtOne);
+    const __m128d halfVec = _mm_set1_pd(0.5);
+    const __m128d twoVec = _mm_set1_pd(2.0);
+    const __m128d keepMask = excluded ? _mm_setzero_pd() : _mm_castsi128_pd(_mm_set1_epi32(-1));
+
+    for (; i + 2 <= last; i += 2) {
+        __m128d scanFactor = _mm_mul_pd(invSigmaVec, _mm_sqrt_pd(_mm_loadu_pd(weightSum + i)));
+
+        __m128d coeffA = _mm_add_pd(_mm_loadu_pd(coeffSumA + i), _mm_mul_pd(_mm_mul_pd(scanFactor, scanFactor), halfVec));
+        __m128d coeffB = _mm_add_pd(_mm_loadu_pd(coeffSumB + i), _mm_div_pd(_mm_mul_pd(scanFactor, _mm_loadu_pd(powers + i)), _mm_loadu_pd(sigmaCombined + i)));
+        _mm_storeu_pd(coeffSumA + i, coeffA);
+        _mm_storeu_pd(coeffSumB + i, coeffB);
+
+        __m128d root = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(coeffB, coeffB), _mm_mul_pd(factorVec, coeffA)));
+        __m128d strength = _mm_div_pd(_mm_add_pd(coeffB, root), _mm_mul_pd(twoVec, coeffA));
+        _mm_storeu_pd(exclusionPowers + i, _mm_and_pd(strength, keepMask));
+    }
+#endif
+
+    // Scalar fallback and tail
+    for (; i < last; i++) {
+        double scanFactor = invSigmaProc*std::sqrt(weightSum[i]);
+
+        coeffSumA[i] += scanFactor*scanFactor*0.5;
+        coeffSumB[i] += scanFactor*powers[i]/sigmaCombined[i];
+
+        double coeffA = coeffSumA[i];
+        double coeffB = coeffSumB[i];
+
+        double strength = (coeffB + std::sqrt(coeffB*coeffB + fourLnPtOne*coeffA))/(2*coeffA);
+        exclusionPowers[i] = excluded ? 0 : strength;
     }
 }
 
 
 
 /**
- * @brief Prepare to take data, moving forward by a given step size
+ * @brief Prepare to take data, moving forward by a given step size. Bins that fall below the new startIndex are final and move from the
+ * window to finalizedBins, so the window stays one spectrum wide however long the scan.
+ * 
+ * @warning The owner has to take finalizedBins between steps (ScanRunner::saveState does). Throws if more than MAX_FINALIZED_BINS are still
+ * waiting from earlier steps.
  * 
  * @param stepSize - the size of the step to take in MHz
  */
 void BayesFactors::step(double stepSize){
+    if (finalizedBins.powers.size() > MAX_FINALIZED_BINS) {
+        throw std::runtime_error("Error: " + std::to_string(finalizedBins.powers.size()) + " finalized exclusion line bins were never saved. " +
+            "Call ScanRunner::saveState between steps\n");
+    }
+
     double shift = 0;
 
+    int firstNewBin = totalBins();
+    dirtyIndex = (firstNewBin < dirtyIndex) ? firstNewBin : dirtyIndex;
+
     while(shift <= stepSize){
         shift += freqRes;
         startIndex += 1;
@@ -89,4 +192,19 @@ void BayesFactors::step(double stepSize){
         coeffSumA.push_back(0);
         coeffSumB.push_back(0);
     }
+
+
+    // Slide the window up to startIndex
+    int finalized = startIndex - baseIndex;
+    if (finalized > 0) {
+        finalizedBins.powers.insert(finalizedBins.powers.end(), exclusionLine.powers.begin(), exclusionLine.powers.begin() + finalized);
+        finalizedBins.freqAxis.insert(finalizedBins.freqAxis.end(), exclusionLine.freqAxis.begin(), exclusionLine.freqAxis.begin() + finalized);
+
+        exclusionLine.powers.erase(exclusionLine.powers.begin(), exclusionLine.powers.begin() + finalized);
+        exclusionLine.freqAxis.erase(exclusionLine.freqAxis.begin(), exclusionLine.freqAxis.begin() + finalized);
+        coeffSumA.erase(coeffSumA.begin(), coeffSumA.begin() + finalized);
+        coeffSumB.erase(coeffSumB.begin(), coeffSumB.begin() + finalized);
+
+        baseIndex = startIndex;
+    }
 }
\ No newline at end of file
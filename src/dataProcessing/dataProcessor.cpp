@@ -13,6 +13,43 @@
 
 #include "decs.hpp"
 
+DataProcessor::DataProcessor(const DataProcessor& other) {
+    *this = other;
+}
+
+
+/**
+ * @brief Copies everything but the filter state. DspFilters objects keep pointers into their own coefficient and state storage, so a memberwise 
+ * copy would leave both processors filtering through the same state. The filter is set up again from the other's parameters and starts 
+ * cleared.
+ * 
+ * @param other - Processor to copy
+ * @return DataProcessor& - this
+ */
+DataProcessor& DataProcessor::operator=(const DataProcessor& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    badBins = other.badBins;
+    DCbins = other.DCbins;
+
+    numSpectra = other.numSpectra;
+    runningAverage = other.runningAverage;
+    currentBaseline = other.currentBaseline;
+    SNR = other.SNR;
+    trimmedSNR = other.trimmedSNR;
+
+    chebyshevFilter.setParams(other.chebyshevFilter.getParams());
+    chebyshevFilter.reset();
+
+    cutoffFrequency_ = other.cutoffFrequency_;
+    sampleRate_ = other.sampleRate_;
+
+    return *this;
+}
+
+
 void DataProcessor::displayState(){
     // plt::figure();
 
@@ -198,6 +235,30 @@ void DataProcessor::addRawSpectrumToRunningAverage(std::vector<double> rawSpectr
 
 
 
+/**
+ * @brief Adds the average of count raw spectra to the running average, weighted as if they had been added one at a time.
+ *
+ * @param averagedSpectrum - Average of the count spectra
+ * @param count - Number of spectra averagedSpectrum stands for
+ */
+void DataProcessor::addAveragedSpectrumToRunningAverage(const std::vector<double>& averagedSpectrum, int count) {
+    if (runningAverage.empty()) {
+        runningAverage = averagedSpectrum;
+        numSpectra = count;
+        return;
+    }
+
+    numSpectra += count;
+
+    double factor = (double)(numSpectra - count) / (double)numSpectra;
+    double weight = (double)count / (double)numSpectra;
+    for (size_t i = 0; i < runningAverage.size(); i++) {
+        runningAverage[i] = factor * runningAverage[i] + weight * averagedSpectrum[i];
+    }
+}
+
+
+
 std::vector<double> DataProcessor::removeBadBins(std::vector<double> unfilteredRawSpectrum) {
     std::vector<double> filteredSpectrum = unfilteredRawSpectrum;
 
@@ -219,14 +280,7 @@ std::vector<double> DataProcessor::removeBadBins(std::vector<double> unfilteredR
 std::vector<double> DataProcessor::trimDC(std::vector<double> untrimmedSpectrum){
     std::vector<double> filteredSpectrum = untrimmedSpectrum;
 
-    if (DCbins.empty()) {
-        int i = findClosestIndex(SNR.freqAxis, -0.005);
-
-        while(SNR.freqAxis[i] <= 0.005){
-            DCbins.push_back(i);
-            i++;
-        }
-    }
+    findDCbins();
 
     double fillValue = (
         untrimmedSpectrum[(DCbins[0]-1)] +
@@ -243,38 +297,87 @@ std::vector<double> DataProcessor::trimDC(std::vector<double> untrimmedSpectrum)
 
 
 
-std::vector<std::vector<double>> DataProcessor::acquiredToRaw(fftw_complex* rawStream, int spectraPerAcquisition, int samplesPerSpectrum, fftw_plan plan){
-    // Slice the rawStream into subStreams and store them in the rawData vector
-    std::vector<fftw_complex*> procData(spectraPerAcquisition);
-
-    for (int i = 0; i < spectraPerAcquisition; ++i) {
-        int startIndex = i * samplesPerSpectrum;
-        fftw_complex* subStream = (fftw_complex*) fftw_malloc(samplesPerSpectrum * sizeof(fftw_complex));
+/**
+ * @brief Finds the bins within 5 kHz of DC on the SNR frequency axis, the first time it is called.
+ *
+ */
+void DataProcessor::findDCbins() {
+    if (DCbins.empty()) {
+        int i = findClosestIndex(SNR.freqAxis, -0.005);
 
-        for (int j = 0; j < samplesPerSpectrum; ++j) {
-            subStream[j][0] = rawStream[startIndex + j][0]; // Real part
-            subStream[j][1] = rawStream[startIndex + j][1]; // Imaginary part
+        while(SNR.freqAxis[i] <= 0.005){
+            DCbins.push_back(i);
+            i++;
         }
+    }
+}
+
+
+
+/**
+ * @brief In place equivalent of trimDC(removeBadBins(spectrum)). Both fills are linear, so masking an averaged spectrum gives the same result
+ * as averaging masked spectra.
+ *
+ * @param spectrum - Raw power spectrum, masked in place
+ */
+void DataProcessor::maskBadBinsAndDC(std::vector<double>& spectrum) {
+    size_t size = spectrum.size();
+
+    // Bad bin fills are taken from the unmasked spectrum, so find them all before writing any
+    std::vector<double> fillValues(badBins.size());
+    for (size_t n = 0; n < badBins.size(); n++) {
+        int index = badBins[n];
+        fillValues[n] = (spectrum[(index + 50) % size] + spectrum[(index + size - 50) % size]) / 2.0;
+    }
+    for (size_t n = 0; n < badBins.size(); n++) {
+        spectrum[badBins[n]] = fillValues[n];
+    }
 
-        procData[i] = processDataFFT(subStream, plan, samplesPerSpectrum);
+    // Replace DC bins with a flat average fill
+    findDCbins();
 
-        fftw_free(subStream);
+    double fillValue = (spectrum[DCbins[0]-1] + spectrum[DCbins[DCbins.size()-1]+1]) / 2.0;
+    for (int index : DCbins) {
+        spectrum[index] = fillValue;
     }
+}
+
 
 
-    // Process the data into voltages
-    std::vector<std::vector<double>> fftVoltage(spectraPerAcquisition);
-    std::vector<std::vector<double>> fftPower(spectraPerAcquisition);
+/**
+ * @brief Transforms an acquisition of spectraPerAcquisition contiguous buffers into raw power spectra. The buffers are transformed straight out
+ * of rawStream, batchSize at a time, so only the FFT output needs scratch space.
+ *
+ * @param rawStream - spectraPerAcquisition*samplesPerSpectrum voltages, as returned by AcquireData. Not modified
+ * @param spectraPerAcquisition - Number of buffers in rawStream
+ * @param samplesPerSpectrum - Samples per buffer
+ * @param plan - Single buffer plan, used for the buffers left over after the last full batch
+ * @param batchPlan - batchSize buffer plan from planFFTBatch
+ * @param batchSize - Number of buffers batchPlan transforms
+ * @return std::vector<std::vector<double>> - Power spectrum of each buffer
+ */
+std::vector<std::vector<double>> DataProcessor::acquiredToRaw(fftw_complex* rawStream, int spectraPerAcquisition, int samplesPerSpectrum, fftw_plan plan, fftw_plan batchPlan, int batchSize){
+    fftw_complex* fftData = (fftw_complex*) fftw_malloc((size_t)batchSize * samplesPerSpectrum * sizeof(fftw_complex));
+
+    std::vector<std::vector<double>> fftPower(spectraPerAcquisition, std::vector<double>(samplesPerSpectrum));
+
+    for (int first = 0; first < spectraPerAcquisition; first += batchSize) {
+        int count = (spectraPerAcquisition - first < batchSize) ? spectraPerAcquisition - first : batchSize;
 
-    for (int i=0; i < spectraPerAcquisition; i++) {
-        for (int j=0; j < samplesPerSpectrum; j++){
-            fftPower[i].push_back(( procData[i][j][0]*procData[i][j][0] + procData[i][j][1]*procData[i][j][1] ) / samplesPerSpectrum / 50); // Hard code in 50 Ohm input impedance
+        executeFFTBatch(plan, batchPlan, batchSize, samplesPerSpectrum, rawStream + (size_t)first*samplesPerSpectrum, fftData, count);
+
+        // Process the data into powers
+        for (int k = 0; k < count; k++) {
+            fftw_complex* spectrum = fftData + (size_t)k*samplesPerSpectrum;
+            std::vector<double>& power = fftPower[first + k];
+
+            for (int j=0; j < samplesPerSpectrum; j++){
+                power[j] = ( spectrum[j][0]*spectrum[j][0] + spectrum[j][1]*spectrum[j][1] ) / samplesPerSpectrum / 50; // Hard code in 50 Ohm input impedance
+            }
         }
     }
 
-    for (fftw_complex* data : procData) {
-        fftw_free(data);
-    }
+    fftw_free(fftData);
 
     return fftPower;
 }
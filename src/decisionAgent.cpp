@@ -26,6 +26,7 @@ void DecisionAgent::resizeSNRtoMatch(CombinedSpectrum spectrum) {
 void DecisionAgent::resizeSNRtoMatch(Spectrum spectrum) {
     trimmedSNR.powers.clear();
     trimmedSNR.freqAxis.clear();
+    score = 0;
 
     trimmedSNR.powers.resize(spectrum.freqAxis.size());
     trimmedSNR.freqAxis.resize(spectrum.freqAxis.size());
@@ -103,7 +104,7 @@ void DecisionAgent::setPoints(){
 }
 
 
-int DecisionAgent::getDecision(std::vector<double> activeExclusionLine, int numShots){
+int DecisionAgent::getDecision(std::vector<double> const& activeExclusionLine, int numShots){
     if (decisionMaking && (numShots > (minSpectra - 3))){ // 3 spectra to account for decision delay
         return (checkScore(activeExclusionLine) <= threshold);
     } else {
@@ -112,13 +113,11 @@ int DecisionAgent::getDecision(std::vector<double> activeExclusionLine, int numS
 }
 
 
-double DecisionAgent::checkScore(std::vector<double> activeExclusionLine){
+double DecisionAgent::checkScore(std::vector<double> const& activeExclusionLine){
     double score = 0;
 
     for (std::size_t i=0; i < activeExclusionLine.size(); i++){
-        if (activeExclusionLine[i] > inProgressTargets[i]){
-            score += points[i]*(activeExclusionLine[i]/inProgressTargets[i])*(activeExclusionLine[i]/inProgressTargets[i]);
-        } 
+        score += binScore((int)i, activeExclusionLine[i]);
     }
     
     return score;
@@ -126,6 +125,54 @@ double DecisionAgent::checkScore(std::vector<double> activeExclusionLine){
 
 
 
+/**
+ * @brief Same decision as getDecision(activeExclusionLine, numShots), made on the score of the last updateScore.
+ * 
+ * @param numShots - Spectra decided so far in this step
+ * @return int - 1 if the step has reached its target
+ */
+int DecisionAgent::getDecision(int numShots){
+    if (decisionMaking && (numShots > (minSpectra - 3))){ // 3 spectra to account for decision delay
+        return (score <= threshold);
+    } else {
+        return 0;
+    }
+}
+
+
+
+/**
+ * @brief Scores the active window straight from the exclusion line, so nothing is copied out of it. Same sum as checkScore on the window, 
+ * in one pass.
+ * 
+ * @param bayesFactors - Exclusion state after the update
+ */
+void DecisionAgent::updateScore(BayesFactors const& bayesFactors){
+    int windowSize = (int)trimmedSNR.powers.size();
+    int windowStart = bayesFactors.totalBins() - windowSize;
+    const double* exclusionPowers = bayesFactors.exclusionLine.powers.data() + (windowStart - bayesFactors.baseIndex);
+
+    score = 0;
+    for (int i = 0; i < windowSize; i++) {
+        score += binScore(i, exclusionPowers[i]);
+    }
+}
+
+
+
+/**
+ * @brief Term of bin i of the window in the score: points weighted by the square of how far the exclusion is above its in-progress target.
+ * 
+ */
+double DecisionAgent::binScore(int i, double exclusionPower) const {
+    if (exclusionPower > inProgressTargets[i]){
+        return points[i]*(exclusionPower/inProgressTargets[i])*(exclusionPower/inProgressTargets[i]);
+    }
+    return 0;
+}
+
+
+
 void DecisionAgent::toggleDecisionMaking(bool decisionMaking) {
     this->decisionMaking = decisionMaking;
 }
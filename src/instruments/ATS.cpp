@@ -436,9 +436,6 @@ fftw_complex* ATS::AcquireData() {
 		}
 	}
 
-    std::vector<unsigned short> fullDataA;
-    std::vector<unsigned short> fullDataB;
-
     fftw_complex* complexOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * acquisitionParams.samplesPerAcquisition));
 
 	// Wait for each buffer to be filled, process the buffer, and re-post it to the board.
@@ -477,26 +474,13 @@ fftw_complex* ATS::AcquireData() {
 			if (retCode == ApiSuccess) {
                 // DWORD startProcTickCount = GetTickCount();
 
-                std::vector<unsigned short> bufferData(reinterpret_cast<unsigned short*>(pIoBuffer->pBuffer),
-                                      reinterpret_cast<unsigned short*>(pIoBuffer->pBuffer) + (acquisitionParams.bytesPerBuffer / sizeof(unsigned short)));
-
-                // Deprecated from before I was using FFTW immediately after acquisition
-                fullDataA.insert(fullDataA.end(), bufferData.begin(), bufferData.begin() + bufferData.size()/2);
-                fullDataB.insert(fullDataB.end(), bufferData.begin() + bufferData.size()/2, bufferData.end());
-
-                // Current implementation - pre processes the data into a complex array for FFT
-                for (unsigned int i=0; i < bufferData.size()/2; i++) {
-                    int index = buffersCompleted*acquisitionParams.samplesPerBuffer + i;
-
-                    complexOutput[index][0] = (bufferData[i]   / (double)0xFFFF) * 2 * acquisitionParams.inputRange - acquisitionParams.inputRange;
-                    complexOutput[index][1] = (bufferData[bufferData.size()/2 + i]  / (double)0xFFFF) * 2 * acquisitionParams.inputRange - acquisitionParams.inputRange;
+                // Read straight out of the DMA buffer: channel A in the first half, channel B in the second
+                const U16* samplesA = reinterpret_cast<const U16*>(pIoBuffer->pBuffer);
+                const U16* samplesB = samplesA + acquisitionParams.samplesPerBuffer;
 
-                    // WARNING: Alternating signs trick to 0-center the dft
-                    if (index % 2 == 1) {
-                        complexOutput[index][0] *= -1;
-                        complexOutput[index][1] *= -1;
-                    }
-                }
+                // Pre processes the data into a complex array for FFT (includes the alternating signs trick to 0-center the dft)
+                U32 firstIndex = buffersCompleted*acquisitionParams.samplesPerBuffer;
+                convertSamplesToComplex(samplesA, samplesB, complexOutput + firstIndex, acquisitionParams.samplesPerBuffer, acquisitionParams.inputRange, firstIndex);
 
                 // double bufferProcTime_sec = (GetTickCount() - startProcTickCount) / 1000.;
 	            // std::cout << "Buffer processed in " << bufferProcTime_sec << " sec" << std::endl;
@@ -556,7 +540,7 @@ fftw_complex* ATS::AcquireData() {
             }
 
 			// If a key was pressed, exit the acquisition loop					
-			if (_kbhit()) {
+			if (keyPressed()) {
 				printf("Aborted...\n");
 				break;
 			}
@@ -656,7 +640,7 @@ std::pair<std::vector<double>, std::vector<double>> processData(std::pair<std::v
  * @return fftw_complex* - Fourier transformed data in the frequency domain
  */
 fftw_complex* processDataFFT(fftw_complex* sampleData, fftw_plan plan, int N) {
-    fftw_complex *FFTData = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * 2 * N));
+    fftw_complex *FFTData = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * N));
     fftw_execute_dft(plan, sampleData, FFTData);
 
     return FFTData;
@@ -668,10 +652,21 @@ fftw_complex* processDataFFT(fftw_complex* sampleData, fftw_plan plan, int N) {
  * @brief Data acquisition loop for the fully parallelized acquisition. Designed to acquire data continuously until the pauseDataCollection flag 
  * is set to true or the fixed horizon is hit. This function will acquire data, process it into voltage, and save it to the sharedData struct.
  * 
- * @param sharedData - Struct containing the shared data between threads. This function will write to dataQueue and signal dataReadyCondition
- * @param syncFlags - Struct containing the synchronization flags between threads. This function will read the pauseDataCollection flag
+ * @param outputQueue - Lanes of converted blocks, one per FFT worker. Each block holds a batch of consecutive buffers (samplesPerBuffer 
+ * fftw_complex each). Blocks are numbered by sequence and dealt round robin. Every lane is ended with an empty handle if the acquisition exits 
+ * unexpectedly, and the buffers of an unfinished batch are dropped
+ * @param bufferPool - Pool the blocks are taken from. Its block size sets the batch size. Blocks return once the FFT thread is done with them
+ * @param triggerEnd - Set by the decision thread to end the acquisition early, and by this function on the final buffer
+ * @param pipelineOverflow - Set by a QUEUE_FLAG_OVERFLOW queue that filled up. Ends the acquisition like a board overflow
+ * @param recorder - If not null, every DMA buffer is copied to this recorder before it is converted and re-posted
+ * @param traceStep - Step number the buffers are tagged with in the pipeline trace
  */
-void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& outputQueue, std::atomic<bool>& triggerEnd) {
+void ATS::AcquireDataMultithreadedContinuous(LanedQueue<PooledBuffer>& outputQueue, BufferPool& bufferPool, std::atomic<bool>& triggerEnd, std::atomic<bool>& pipelineOverflow, RawStreamRecorder* recorder, int traceStep) {
+    AcquisitionMetrics& metrics = acquisitionMetrics();
+
+    // Only this thread knows whether the final block went out. triggerEnd is also written by the decision thread, so it can't tell
+    bool finalPushed = false;
+
     // Set basic flags
     U32 channelMask = CHANNEL_A | CHANNEL_B;
     U32 admaFlags = ADMA_TRIGGERED_STREAMING | ADMA_EXTERNAL_STARTCAPTURE;         // Start acquisition when AlazarStartCapture is called
@@ -737,6 +732,7 @@ void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& out
 	// Wait for each buffer to be filled, process the buffer, and re-post it to the board.
 	if (success) {
         startTimer(TIMER_ACQUISITION);
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
         #if VERBOSE_OUTPUT
 		printf("Capturing %d buffers ... press any key to abort\n", acquisitionParams.buffersPerAcquisition);
         #endif
@@ -745,6 +741,10 @@ void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& out
 		U32 buffersCompleted = 0;
 		INT64 bytesTransferred = 0;
 
+        // Buffers are grouped into pool blocks of batchSize for the batched FFT
+        U32 batchSize = (U32)(bufferPool.getBlockSize()/acquisitionParams.samplesPerBuffer);
+        PooledBuffer batch;
+
         // Main acquisition logic     
 		while (buffersCompleted < acquisitionParams.buffersPerAcquisition) {
             // Signal if this is the last buffer to be acquired
@@ -775,32 +775,56 @@ void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& out
             // Process the buffer that was just filled. This buffer is full and has been removed from the list of buffers available to the board.
 			if (retCode == ApiSuccess) {
                 // DWORD startProcTickCount = GetTickCount();
-                fftw_complex* complexOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * acquisitionParams.samplesPerBuffer));
 
-                std::vector<unsigned short> bufferData(reinterpret_cast<unsigned short*>(pIoBuffer->pBuffer),
-                                      reinterpret_cast<unsigned short*>(pIoBuffer->pBuffer) + (acquisitionParams.bytesPerBuffer / sizeof(unsigned short)));
+                // When the board handed the buffer over, for the pipeline trace
+                std::int64_t acquiredTime = traceEnabled() ? traceClock() : 0;
 
+                if (recorder) {
+                    recorder->record(pIoBuffer->pBuffer);
+                }
 
-                for (unsigned int i=0; i < bufferData.size()/2; i++) {
-                    complexOutput[i][0] = (bufferData[i]   / (double)0xFFFF) * 2 * acquisitionParams.inputRange - acquisitionParams.inputRange;
-                    complexOutput[i][1] = (bufferData[bufferData.size()/2 + i]  / (double)0xFFFF) * 2 * acquisitionParams.inputRange - acquisitionParams.inputRange;
-
-                    // Trick to 0-center the dft
-                    if (i % 2 == 1) {
-                        complexOutput[i][0] *= -1;
-                        complexOutput[i][1] *= -1;
-                    }
+                // Start a new block every batchSize buffers. Blocks if every pool block is still in the pipeline
+                if (batch.empty()) {
+                    batch = bufferPool.acquire();
+                    batch.sequence = buffersCompleted/batchSize;
+                    batch.count = 0;
+                    batch.tag.step = traceStep;
+                    batch.tag.firstBuffer = buffersCompleted;
+                    batch.tag.firstAcquiredTime = acquiredTime;
                 }
+
+                // Convert straight out of the DMA buffer: channel A in the first half, channel B in the second
+                const U16* samplesA = reinterpret_cast<const U16*>(pIoBuffer->pBuffer);
+                const U16* samplesB = samplesA + acquisitionParams.samplesPerBuffer;
+
+                // Includes the trick to 0-center the dft
+                convertSamplesToComplex(samplesA, samplesB, batch.get() + batch.count*acquisitionParams.samplesPerBuffer, 
+                                        acquisitionParams.samplesPerBuffer, acquisitionParams.inputRange, 0);
+                batch.count++;
+                batch.tag.bufferCount = (std::uint32_t)batch.count;
+                batch.tag.acquiredTime = acquiredTime;
+                traceEvent(batch.tag, TRACE_ACQUISITION, TRACE_FINISH);
                 
                 buffersCompleted++;
 				bytesTransferred += acquisitionParams.bytesPerBuffer;	
+                metrics.buffers.add();
+                metrics.samples.add(acquisitionParams.samplesPerBuffer);
 
+                size_t sequence = batch.sequence;
                 if (triggerEnd.load()) {
-                    outputQueue.pushFinal(complexOutput);
+                    traceEvent(batch.tag, TRACE_FFT, TRACE_ENQUEUE);
+                    outputQueue.pushFinal(sequence, std::move(batch));
+                    finalPushed = true;
                     break;
                 }
-                else {
-                    outputQueue.push(complexOutput);
+                else if (batch.count == batchSize) {
+                    traceEvent(batch.tag, TRACE_FFT, TRACE_ENQUEUE);
+                    outputQueue.push(sequence, std::move(batch));
+                }
+
+                if (pipelineOverflow.load()) {
+                    printf("Error: Pipeline queue overflowed\n");
+                    success = FALSE;
                 }
 
                 // std::cout << "Acquired " << buffersCompleted << " buffers." << std::endl;
@@ -863,7 +887,7 @@ void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& out
             }
 	
 			// If a key was pressed, exit the acquisition loop					
-			if (_kbhit()) {
+			if (keyPressed()) {
 				printf("Aborted...\n");
 				break;
 			}
@@ -873,7 +897,13 @@ void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& out
 			printf("Completed %u buffers\r", buffersCompleted);
             #endif
 		}
-        stopTimer(TIMER_ACQUISITION);
+        stopTimer(TIMER_ACQUISITION, buffersCompleted);
+
+        double acquisitionTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        metrics.recordAcquisition(acquisitionParams.samplesPerBuffer, acquisitionParams.sampleRate, buffersCompleted, acquisitionTime);
+        if (!success) {
+            metrics.failures.add();
+        }
 
         #if VERBOSE_OUTPUT
 		double buffersPerSec;
@@ -903,9 +933,9 @@ void ATS::AcquireDataMultithreadedContinuous(ThreadSafeQueue<fftw_complex*>& out
         #endif
 	}
     // Signal end of acquisition if it hasn't already been (this is an unexpected exit)
-    if (!triggerEnd.load()) {
+    if (!finalPushed) {
         triggerEnd = true;
-        outputQueue.pushFinal(nullptr);
+        outputQueue.pushFinalEmpty();
     }
 
 
@@ -0,0 +1,514 @@
+/**
+ * @file simulatedATS.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for SimulatedATS class. See include\instruments\simulatedATS.hpp for class definition.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * @note Every delivered buffer carries its own noise realization: fresh Gaussian spectra shaped by the baseline (and axion) power are
+ * brought to the time domain with one inverse FFT, then the coherent spurs are added. Averaged spectra therefore converge on the shape
+ * like real data. simParams.uniqueBuffers switches to a small pre-generated bank instead, which is cheaper but repeats, so the averaged
+ * spectrum keeps a fixed per-bin pattern. Only use it to measure pipeline throughput.
+ *
+ * @warning Data is laid out exactly like the ATS9462 DMA buffers (all of channel A followed by all of channel B) and converted with the
+ * same alternating sign trick, so spectra come out of the pipeline centered at 0 just like real data.
+ *
+ */
+
+#include "decs.hpp"
+
+#define VERBOSE_OUTPUT (0)
+#define SIMULATED_BITS_PER_SAMPLE (16)
+
+
+/**
+ * @brief Construct a new SimulatedATS::SimulatedATS object. IDs are accepted for drop in compatibility with ATS and otherwise ignored.
+ *
+ * @param systemId
+ * @param boardId
+ */
+SimulatedATS::SimulatedATS(int systemId, int boardId) : generator(simParams.seed) {
+    std::cout << "Using simulated digitizer in place of system ID " << std::to_string(systemId) << " board ID " << std::to_string(boardId) << std::endl;
+}
+
+
+SimulatedATS::~SimulatedATS() {
+    if (noisePlan) {
+        fftwf_destroy_plan(noisePlan);
+    }
+    fftwf_free(noiseSpectrum);
+    fftwf_free(noiseTimeSeries);
+}
+
+
+
+/**
+ * @brief Forces the noise shape (and bank) to be regenerated and the generator to be reseeded on the next acquisition. Call after changing simParams.
+ *
+ */
+void SimulatedATS::refreshSimulation() {
+    generator.seed(simParams.seed);
+    bankValid = false;
+}
+
+
+
+/**
+ * @brief Suggests a number of buffers to use for a given sample rate and number of samples per acquisition. Mirrors ATS::suggestBufferNumber
+ * with the ATS9462's 16 bit sample size.
+ *
+ * @param sampleRate - desired sample rate in Hz
+ * @param samplesPerAcquisition - desired number of samples over the full acquisition
+ * @return U32 - suggested number of buffers to use for given parameters
+ */
+U32 SimulatedATS::suggestBufferNumber(U32 sampleRate, U32 samplesPerAcquisition) {
+    int channelCount = 2;
+    int desiredBytesPerBuffer = (int)2e6; // Shoot for 2MB buffer sizes
+
+    U32 bytesPerSample = (SIMULATED_BITS_PER_SAMPLE + 7) / 8;
+    U32 buffersPerAcquisition = (U32)std::round(bytesPerSample * samplesPerAcquisition * channelCount / desiredBytesPerBuffer);
+    if (buffersPerAcquisition < 1) { buffersPerAcquisition = 1; }
+
+    // Make sure the number of buffers evenly divides the number of samples
+    int spread = 1;
+    while((samplesPerAcquisition % buffersPerAcquisition != 0)) {
+        if (samplesPerAcquisition % (buffersPerAcquisition + spread) == 0) {
+            buffersPerAcquisition = buffersPerAcquisition + spread;
+        }
+        else if (buffersPerAcquisition > (U32)spread && samplesPerAcquisition % (buffersPerAcquisition - spread) == 0) {
+            buffersPerAcquisition = buffersPerAcquisition - spread;
+        }
+        spread++;
+    }
+
+    return buffersPerAcquisition;
+}
+
+
+
+void SimulatedATS::printBufferSize(U32 samplesPerAcquisition, U32 buffersPerAcquisition) {
+    U32 bytesPerSample = (SIMULATED_BITS_PER_SAMPLE + 7) / 8;
+    double megaBytesPerBuffer = bytesPerSample * samplesPerAcquisition / buffersPerAcquisition / 1e6;
+
+    std::cout << "Acquisition parameters result in buffer size of " << std::to_string(megaBytesPerBuffer) << "MB per buffer." << std::endl;
+}
+
+
+
+/**
+ * @brief Sets the acquisition parameters for the simulated board. Fills the acquisitionParams struct exactly like ATS::setAcquisitionParameters
+ * but without talking to hardware, so the requested sample rate is always honored.
+ *
+ * @param sampleRate - desired sample rate in Hz
+ * @param samplesPerAcquisition - desired number of samples over the full acquisition
+ * @param buffersPerAcquisition - desired number of buffers to split the acquisition into. If 0, will be calculated automatically.
+ * @param inputRange - full scale voltage range used to quantize the synthetic signal
+ * @param inputImpedance - recorded for compatibility, not used
+ */
+void SimulatedATS::setAcquisitionParameters(U32 sampleRate, U32 samplesPerAcquisition, U32 buffersPerAcquisition, double inputRange, double inputImpedance) {
+    if (buffersPerAcquisition <= 0){
+        buffersPerAcquisition = suggestBufferNumber(sampleRate, samplesPerAcquisition);
+    }
+    printBufferSize(samplesPerAcquisition, buffersPerAcquisition);
+
+    int channelCount = 2;
+    U32 recordsPerBuffer = 1;
+
+    acquisitionParams.sampleRate = sampleRate;
+    acquisitionParams.buffersPerAcquisition = buffersPerAcquisition;
+    acquisitionParams.inputRange = inputRange;
+    acquisitionParams.inputImpedance = inputImpedance;
+    acquisitionParams.recordsPerAcquisition = recordsPerBuffer*buffersPerAcquisition;
+
+    acquisitionParams.samplesPerBuffer = samplesPerAcquisition/buffersPerAcquisition;
+    acquisitionParams.bytesPerSample = (SIMULATED_BITS_PER_SAMPLE + 7) / 8;
+    acquisitionParams.bytesPerBuffer = acquisitionParams.bytesPerSample * acquisitionParams.samplesPerBuffer * channelCount;
+
+    acquisitionParams.samplesPerAcquisition = acquisitionParams.samplesPerBuffer*acquisitionParams.buffersPerAcquisition;
+
+    // Stand-ins for the DMA buffers posted to the board
+    for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++) {
+        dmaBuffers[bufferIndex].assign(acquisitionParams.samplesPerBuffer * channelCount, 0x8000);
+    }
+
+    bankValid = false;
+}
+
+
+
+/**
+ * @brief Power gain of the simulated receive chain: 4th order amplifier roll off, a standing wave ripple and a Lorentzian cavity bump.
+ *
+ * @param ifFrequency - frequency relative to the center frequency in MHz
+ * @return double - power gain, 1 at DC with the cavity and ripple switched off
+ */
+double SimulatedATS::baselineGain(double ifFrequency) {
+    double rollOff = 1/(1 + std::pow(ifFrequency/simParams.amplifierRollOff, 4));
+    double ripple = 1 + simParams.rippleAmplitude*std::cos(2*M_PI*ifFrequency/simParams.ripplePeriod);
+
+    double detuning = 2*(ifFrequency - simParams.cavityOffset)/simParams.cavityLinewidth;
+    double cavity = 1 + simParams.cavityContrast/(1 + detuning*detuning);
+
+    return rollOff*ripple*cavity;
+}
+
+
+
+/**
+ * @brief Maxwellian axion lineshape normalized to a peak of 1. Zero below the onset frequency.
+ *
+ * @param absFrequency - absolute frequency in MHz
+ * @return double - lineshape value
+ */
+double SimulatedATS::axionShape(double absFrequency) {
+    if (!simParams.injectAxion) { return 0; }
+
+    double x = (absFrequency - simParams.axionFrequency)/simParams.axionLinewidth;
+    if (x < 0) { return 0; }
+
+    return std::sqrt(2*x)*std::exp(0.5 - x);
+}
+
+
+
+/**
+ * @brief Prepares the noise shape, the inverse FFT and the spur buffer for the current acquisition geometry if they are stale, and fills the
+ * noise bank when simParams.uniqueBuffers asks for one. Noise is shaped in the frequency domain and brought to the time domain with an
+ * inverse FFT so the pipeline sees exactly baselineGain() (times the axion excess) in every bin.
+ *
+ */
+void SimulatedATS::prepareBank() {
+    bool axionMoved = simParams.injectAxion && (simParams.centerFrequency != bankCenterFrequency);
+    if (bankValid && !axionMoved) { return; }
+
+    int N = (int)acquisitionParams.samplesPerBuffer;
+    double binWidth = acquisitionParams.sampleRate/(double)N/1e6; // MHz
+
+    // Power shape in natural FFT order, bin k sits at k*binWidth for k < N/2 and wraps to negative frequencies above
+    noiseAmplitudes.resize(N);
+    for (int k = 0; k < N; k++) {
+        double ifFrequency = ((k < N/2) ? k : k - N)*binWidth;
+        double shape = baselineGain(ifFrequency)*(1 + simParams.axionPower*axionShape(simParams.centerFrequency + ifFrequency));
+
+        // Unnormalized inverse FFT, so scale by 1/N in power to get noiseAmplitude RMS per channel at unit gain
+        noiseAmplitudes[k] = (float)(simParams.noiseAmplitude*std::sqrt(shape/N));
+    }
+
+    // The plan only depends on the buffer size, so it survives center frequency changes
+    if (noisePlanSize != N) {
+        if (noisePlan) {
+            fftwf_destroy_plan(noisePlan);
+        }
+        fftwf_free(noiseSpectrum);
+        fftwf_free(noiseTimeSeries);
+
+        noiseSpectrum = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * N));
+        noiseTimeSeries = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * N));
+        noisePlan = fftwf_plan_dft_1d(N, noiseSpectrum, noiseTimeSeries, FFTW_BACKWARD, FFTW_ESTIMATE);
+        noisePlanSize = N;
+    }
+
+    int numBuffers = (simParams.uniqueBuffers > 1) ? simParams.uniqueBuffers : 0;
+    noiseBank.assign(numBuffers, std::vector<std::complex<float>>(N));
+
+    const std::complex<float>* noise = reinterpret_cast<const std::complex<float>*>(noiseTimeSeries);
+    for (int b = 0; b < numBuffers; b++) {
+        synthesizeNoise();
+        noiseBank[b].assign(noise, noise + N);
+    }
+
+
+    // Coherent spurs are complex tones, so each shows up once at its signed IF frequency
+    spurBuffer.assign(N, std::complex<float>(0, 0));
+    for (double spurFrequency : simParams.spurFrequencies) {
+        double spurAmplitude = simParams.spurAmplitude*std::sqrt(baselineGain(spurFrequency));
+        double phaseStep = 2*M_PI*spurFrequency*1e6/acquisitionParams.sampleRate;
+
+        for (int n = 0; n < N; n++) {
+            spurBuffer[n] += std::polar((float)spurAmplitude, (float)(phaseStep*n));
+        }
+    }
+
+    bankCenterFrequency = simParams.centerFrequency;
+    bankValid = true;
+}
+
+
+
+/**
+ * @brief Draws one independent noise realization into noiseTimeSeries. Each bin gets a complex Gaussian scaled by noiseAmplitudes, made
+ * with Box-Muller straight from the generator since std::normal_distribution would make synthesis slower than the pipeline.
+ *
+ */
+void SimulatedATS::synthesizeNoise() {
+    int N = noisePlanSize;
+    const float uniformScale = 1.0f/4294967296.0f;
+    const float twoPi = (float)(2*M_PI);
+
+    for (int k = 0; k < N; k++) {
+        // u1 in (0, 1] keeps the log finite
+        float u1 = ((float)generator() + 1.0f)*uniformScale;
+        float u2 = (float)generator()*uniformScale;
+
+        float radius = noiseAmplitudes[k]*std::sqrt(-2*std::log(u1));
+        noiseSpectrum[k][0] = radius*std::cos(twoPi*u2);
+        noiseSpectrum[k][1] = radius*std::sin(twoPi*u2);
+    }
+
+    fftwf_execute(noisePlan);
+}
+
+
+
+/**
+ * @brief Readies the sample source for the next acquisition. With simParams.replayPath set the recording is mapped (once per file) and
+ * checked against the acquisition geometry, and the input range is taken from the recording so codes convert to the recorded voltages.
+ * Otherwise the noise bank is prepared.
+ *
+ */
+void SimulatedATS::prepareSource() {
+    if (simParams.replayPath.empty()) {
+        replay.close();
+        prepareBank();
+        return;
+    }
+
+    if (!replay.isOpen() || replay.getFilename() != simParams.replayPath) {
+        replay.open(simParams.replayPath);
+        std::cout << "Replaying " << replay.getBufferCount() << " raw buffers from " << simParams.replayPath << std::endl;
+    }
+
+    RawStreamHeader const& header = replay.getHeader();
+    if (header.channelCount != 2 || header.bytesPerSample != sizeof(U16) || header.samplesPerBuffer != acquisitionParams.samplesPerBuffer) {
+        throw std::runtime_error("Error: " + simParams.replayPath + " holds " + std::to_string(header.samplesPerBuffer) +
+            " samples per buffer, the acquisition expects " + std::to_string(acquisitionParams.samplesPerBuffer));
+    }
+
+    if ((U32)header.sampleRate != acquisitionParams.sampleRate) {
+        std::cout << "Warning: " << simParams.replayPath << " was recorded at " << header.sampleRate << " Hz, replaying as " <<
+            acquisitionParams.sampleRate << " Hz" << std::endl;
+    }
+    acquisitionParams.inputRange = header.inputRange;
+}
+
+
+
+/**
+ * @brief Next buffer of the acquisition. Points straight into the mapped recording when replaying (looping over it if the acquisition is
+ * longer), otherwise synthesizes into the DMA buffer stand-ins.
+ *
+ * @param bufferIndex - Buffer number within the acquisition
+ * @return const U16* - 2*samplesPerBuffer codes, channel A followed by channel B
+ */
+const U16* SimulatedATS::nextBuffer(U32 bufferIndex) {
+    if (replay.isOpen()) {
+        return replay.buffer(bufferIndex % replay.getBufferCount());
+    }
+
+    U16* pBuffer = dmaBuffers[bufferIndex % BUFFER_COUNT].data();
+    fillBuffer(pBuffer);
+    return pBuffer;
+}
+
+
+
+/**
+ * @brief Fills one DMA-style buffer with quantized samples, channel A in the first half and channel B in the second.
+ *
+ * @param buffer - destination with room for 2*samplesPerBuffer codes
+ */
+void SimulatedATS::fillBuffer(U16* buffer) {
+    U32 N = acquisitionParams.samplesPerBuffer;
+    int numBuffers = (int)noiseBank.size();
+    std::complex<float>* noise = reinterpret_cast<std::complex<float>*>(noiseTimeSeries);
+
+    if (numBuffers == 0) {
+        synthesizeNoise();
+    }
+    else {
+        // Throughput mode: sum two distinct realizations of the bank so consecutive buffers are not identical
+        std::uniform_int_distribution<int> pick(0, numBuffers - 1);
+        int first = pick(generator);
+        int second = (first + 1 + pick(generator) % (numBuffers - 1)) % numBuffers;
+
+        const std::complex<float>* noiseA = noiseBank[first].data();
+        const std::complex<float>* noiseB = noiseBank[second].data();
+        for (U32 n = 0; n < N; n++) {
+            noise[n] = (noiseA[n] + noiseB[n])*(float)M_SQRT1_2;
+        }
+    }
+
+    const std::complex<float>* spurs = spurBuffer.data();
+
+    // Sample codes are unsigned: 0x0000 is negative full scale, 0x8000 is 0V and 0xFFFF is positive full scale
+    float range = (float)acquisitionParams.inputRange;
+    float codeScale = (float)0xFFFF/(2*range);
+
+    for (U32 n = 0; n < N; n++) {
+        std::complex<float> voltage = noise[n] + spurs[n];
+
+        float codeA = (voltage.real() + range)*codeScale + 0.5f;
+        float codeB = (voltage.imag() + range)*codeScale + 0.5f;
+
+        // Clip to the ADC range
+        codeA = (codeA < 0) ? 0 : ((codeA > (float)0xFFFF) ? (float)0xFFFF : codeA);
+        codeB = (codeB < 0) ? 0 : ((codeB > (float)0xFFFF) ? (float)0xFFFF : codeB);
+
+        buffer[n]     = (U16)codeA;
+        buffer[N + n] = (U16)codeB;
+    }
+}
+
+
+
+/**
+ * @brief Simulated equivalent of ATS::AcquireData. Generates the full acquisition and converts it into a single fftw_complex array.
+ *
+ * @warning This function will allocate memory for the raw data. It is the caller's responsibility to free this memory.
+ * @warning Alternating signs applied to the real and imaginary components of the output to center the assumed DFT at 0 later in processing.
+ *
+ * @return fftw_complex* - pointer to the raw data as voltages with channel A and B in real and imaginary components, respectively.
+ */
+fftw_complex* SimulatedATS::AcquireData() {
+    prepareSource();
+
+    fftw_complex* complexOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * acquisitionParams.samplesPerAcquisition));
+
+    U32 N = acquisitionParams.samplesPerBuffer;
+    double range = acquisitionParams.inputRange;
+
+    for (U32 buffersCompleted = 0; buffersCompleted < acquisitionParams.buffersPerAcquisition; buffersCompleted++) {
+        const U16* pBuffer = nextBuffer(buffersCompleted);
+
+        convertSamplesToComplex(pBuffer, pBuffer + N, complexOutput + buffersCompleted*N, N, range, buffersCompleted*N);
+    }
+
+    return complexOutput;
+}
+
+
+
+/**
+ * @brief Simulated equivalent of ATS::AcquireDataMultithreadedContinuous. Produces buffers until the fixed horizon is hit or triggerEnd is set,
+ * converting each into voltages and pushing it to outputQueue.
+ *
+ * @details In real time mode each buffer is released no earlier than the time the card would have finished filling it (scaled by
+ * simParams.speed). If the loop falls more than BUFFER_COUNT buffers behind that schedule the real card would have run out of DMA buffers, so
+ * the acquisition stops with the same overflow error the board reports.
+ *
+ * @param outputQueue - Lanes to deal converted blocks to, one per FFT worker. Each block holds a batch of consecutive buffers. The last block
+ * is pushed with pushFinal, empty handles on an unexpected exit.
+ * @param bufferPool - Pool the blocks are taken from. Its block size sets the batch size.
+ * @param triggerEnd - Set by the decision thread to end the acquisition early, and by this function on the final buffer.
+ * @param pipelineOverflow - Set by a QUEUE_FLAG_OVERFLOW queue that filled up. Ends the acquisition like a board overflow.
+ * @param recorder - If not null, every buffer is also handed to this recorder
+ * @param traceStep - Step number the buffers are tagged with in the pipeline trace
+ */
+void SimulatedATS::AcquireDataMultithreadedContinuous(LanedQueue<PooledBuffer>& outputQueue, BufferPool& bufferPool, std::atomic<bool>& triggerEnd, std::atomic<bool>& pipelineOverflow, RawStreamRecorder* recorder, int traceStep) {
+    prepareSource();
+
+    AcquisitionMetrics& metrics = acquisitionMetrics();
+
+    U32 N = acquisitionParams.samplesPerBuffer;
+    double range = acquisitionParams.inputRange;
+
+    double speed = (simParams.speed > 0) ? simParams.speed : 1;
+    std::chrono::duration<double> bufferDuration((double)N/acquisitionParams.sampleRate/speed);
+
+    // Buffers are grouped into pool blocks of batchSize for the batched FFT
+    U32 batchSize = (U32)(bufferPool.getBlockSize()/N);
+    PooledBuffer batch;
+
+    startTimer(TIMER_ACQUISITION);
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    U32 buffersCompleted = 0;
+
+    // Only this thread knows whether the final block went out. triggerEnd is also written by the decision thread, so it can't tell
+    bool finalPushed = false;
+
+    while (buffersCompleted < acquisitionParams.buffersPerAcquisition) {
+        // Signal if this is the last buffer to be acquired
+        if (buffersCompleted == acquisitionParams.buffersPerAcquisition - 1) {
+            triggerEnd = true;
+        }
+
+        const U16* pBuffer = nextBuffer(buffersCompleted);
+
+        // Release the buffer when the board would have, or give up if every DMA buffer would already be full
+        if (simParams.realTime) {
+            std::chrono::steady_clock::time_point deadline = startTime +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>((buffersCompleted + 1)*bufferDuration);
+
+            if (std::chrono::steady_clock::now() > deadline + std::chrono::duration_cast<std::chrono::steady_clock::duration>(BUFFER_COUNT*bufferDuration)) {
+                printf("Error: Board overflowed on-board memory\n");
+                metrics.failures.add();
+                break;
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+
+        // When the board handed the buffer over, for the pipeline trace
+        std::int64_t acquiredTime = traceEnabled() ? traceClock() : 0;
+
+        if (recorder) {
+            recorder->record(pBuffer);
+        }
+
+        // Start a new block every batchSize buffers
+        if (batch.empty()) {
+            batch = bufferPool.acquire();
+            batch.sequence = buffersCompleted/batchSize;
+            batch.count = 0;
+            batch.tag.step = traceStep;
+            batch.tag.firstBuffer = buffersCompleted;
+            batch.tag.firstAcquiredTime = acquiredTime;
+        }
+        convertSamplesToComplex(pBuffer, pBuffer + N, batch.get() + batch.count*N, N, range, 0);
+        batch.count++;
+        batch.tag.bufferCount = (std::uint32_t)batch.count;
+        batch.tag.acquiredTime = acquiredTime;
+        traceEvent(batch.tag, TRACE_ACQUISITION, TRACE_FINISH);
+
+        buffersCompleted++;
+        metrics.buffers.add();
+        metrics.samples.add(N);
+
+        size_t sequence = batch.sequence;
+        if (triggerEnd.load()) {
+            traceEvent(batch.tag, TRACE_FFT, TRACE_ENQUEUE);
+            outputQueue.pushFinal(sequence, std::move(batch));
+            finalPushed = true;
+            break;
+        }
+        else if (batch.count == batchSize) {
+            traceEvent(batch.tag, TRACE_FFT, TRACE_ENQUEUE);
+            outputQueue.push(sequence, std::move(batch));
+        }
+
+        if (pipelineOverflow.load()) {
+            printf("Error: Pipeline queue overflowed\n");
+            metrics.failures.add();
+            break;
+        }
+    }
+    stopTimer(TIMER_ACQUISITION, buffersCompleted);
+
+    double acquisitionTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    metrics.recordAcquisition(N, acquisitionParams.sampleRate, buffersCompleted, acquisitionTime);
+
+    #if VERBOSE_OUTPUT
+    double transferTime_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double minTime = (double)N/acquisitionParams.sampleRate*buffersCompleted;
+
+    printf("Captured %d buffers in %.3lf sec\n", buffersCompleted, transferTime_sec);
+    printf("Real time would have been %.3lf sec for a duty cycle of %.3lf\n", minTime, minTime/transferTime_sec);
+    #endif
+
+    // Signal end of acquisition if it hasn't already been (this is an unexpected exit)
+    if (!finalPushed) {
+        triggerEnd = true;
+        outputQueue.pushFinalEmpty();
+    }
+}
@@ -0,0 +1,202 @@
+/**
+ * @file kernelBenchmarking.cpp
+ * @author your name (you@domain.com)
+ * @brief Microbenchmarks for the per spectrum processing kernels of DataProcessor, BayesFactors and DecisionAgent on synthetic spectra of
+ *        production size. Built as cpp_kernel_bench from the processing sources only, so it needs neither the Alazar library nor MATLAB.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+// A 32 MS/s, 100 Hz RBW acquisition. Processing trims 10% off each end and rebins by 10
+#define BENCH_SAMPLE_RATE   (32e6)
+#define BENCH_RAW_BINS      (320000)
+#define BENCH_REBIN_WIDTH   (10)
+#define BENCH_SUB_SPECTRA   (20)
+
+void timeKernel(std::string const& name, size_t bins, double bytesPerBin, int repetitions, std::function<void()> const& kernel);
+std::vector<double> syntheticSpectrum(size_t bins, double level, double noise, std::mt19937& generator);
+std::vector<double> syntheticAxis(size_t bins, double resolution);
+
+// Results are folded in here so the compiler can't drop the kernels
+static volatile double sink = 0;
+
+int main(int argc, char** argv) {
+    // Optional scale on the repetitions, e.g. 0.1 for a quick run
+    double scale = (argc > 1) ? std::atof(argv[1]) : 1.0;
+    auto reps = [scale](int repetitions) { return (int)(repetitions*scale) > 1 ? (int)(repetitions*scale) : 1; };
+
+    std::mt19937 generator(1);
+    double resolution = BENCH_SAMPLE_RATE/BENCH_RAW_BINS/1e6;     // MHz
+
+
+    // Processor set up like ScanRunner::initProcessor, with a flat SNR and a 1/f-ish baseline
+    DataProcessor dataProcessor;
+    dataProcessor.setFilterParams(BENCH_SAMPLE_RATE, 3, 10e3, 15);
+
+    dataProcessor.SNR.freqAxis = syntheticAxis(BENCH_RAW_BINS, resolution);
+    dataProcessor.SNR.powers = syntheticSpectrum(BENCH_RAW_BINS, 1, 0.05, generator);
+    dataProcessor.trimmedSNR = dataProcessor.SNR;
+
+    std::vector<double> baseline(BENCH_RAW_BINS);
+    for (int i = 0; i < BENCH_RAW_BINS; i++) {
+        baseline[i] = 1e-6*(1 + 0.5*std::cos(2*M_PI*i/BENCH_RAW_BINS));
+    }
+    dataProcessor.currentBaseline = baseline;
+    dataProcessor.runningAverage = baseline;
+    dataProcessor.badBins = findOutliers(syntheticSpectrum(BENCH_RAW_BINS, 1, 0.2, generator), 25, 5);
+
+    std::vector<std::vector<double>> subSpectra(BENCH_SUB_SPECTRA);
+    for (std::vector<double>& subSpectrum : subSpectra) {
+        subSpectrum = syntheticSpectrum(BENCH_RAW_BINS, 1e-6, 1e-7, generator);
+    }
+
+    Spectrum rawSpectrum;
+    rawSpectrum.powers = averageVectors(subSpectra);
+    rawSpectrum.freqAxis = dataProcessor.SNR.freqAxis;
+
+
+    // The processed and rescaled spectra the later kernels start from
+    Spectrum processedSpectrum, processedBaseline;
+    std::tie(processedSpectrum, processedBaseline) = dataProcessor.rawToProcessed(rawSpectrum);
+    trimSpectrum(processedSpectrum, 0.1);
+    dataProcessor.trimSNRtoMatch(processedSpectrum);
+
+    Spectrum rescaledSpectrum = dataProcessor.processedToRescaled(processedSpectrum);
+    rescaledSpectrum.trueCenterFreq = 5000;
+
+    CombinedSpectrum combinedSpectrum;
+    dataProcessor.addRescaledToCombined(rescaledSpectrum, combinedSpectrum);
+    CombinedSpectrum rebinnedSpectrum = dataProcessor.rebinCombinedSpectrum(combinedSpectrum, BENCH_REBIN_WIDTH, 1);
+    size_t rebinnedBins = rebinnedSpectrum.powers.size();
+
+
+    // Exclusion line and decision agent over the rebinned spectrum
+    BayesFactors bayesFactors;
+    bayesFactors.init(rebinnedSpectrum);
+
+    DecisionAgent decisionAgent;
+    decisionAgent.trimmedSNR.powers = syntheticSpectrum(rebinnedBins, 1, 0.05, generator);
+    decisionAgent.trimmedSNR.freqAxis = rebinnedSpectrum.freqAxis;
+    decisionAgent.targetCoupling = 1;
+    decisionAgent.setTargets();
+    decisionAgent.setPoints();
+    std::vector<double> activeExclusionLine = syntheticSpectrum(rebinnedBins, 1, 0.5, generator);
+
+
+    std::cout << "Kernels on a " << BENCH_RAW_BINS << " bin raw spectrum, " << processedSpectrum.powers.size() << " bins after trimming and "
+              << rebinnedBins << " rebinned bins" << std::endl;
+    std::cout << "GB/s counts each input and output vector once, temporaries are not included" << std::endl << std::endl;
+    fprintf(stdout, "   %-24s %10s %14s %14s %10s\n", "KERNEL", "BINS", "MEDIAN ns/bin", "BEST ns/bin", "GB/s");
+
+    // Raw spectrum kernels
+    timeKernel("rawToProcessed", BENCH_RAW_BINS, 7*sizeof(double), reps(50), [&]() {
+        Spectrum processed, residual;
+        std::tie(processed, residual) = dataProcessor.rawToProcessed(rawSpectrum);
+        sink = sink + processed.powers[0];
+    });
+    timeKernel("updateBaseline", BENCH_RAW_BINS, 2*sizeof(double), reps(50), [&]() {
+        dataProcessor.updateBaseline();
+        sink = sink + dataProcessor.currentBaseline[0];
+    });
+    timeKernel("removeBadBins", BENCH_RAW_BINS, 2*sizeof(double), reps(200), [&]() {
+        sink = sink + dataProcessor.removeBadBins(rawSpectrum.powers)[0];
+    });
+    timeKernel("trimDC", BENCH_RAW_BINS, 2*sizeof(double), reps(200), [&]() {
+        sink = sink + dataProcessor.trimDC(rawSpectrum.powers)[0];
+    });
+    timeKernel("findOutliers", BENCH_RAW_BINS, sizeof(double), reps(5), [&]() {
+        sink = sink + (double)findOutliers(rawSpectrum.powers, 25, 5).size();
+    });
+    timeKernel("averageVectors", BENCH_RAW_BINS, (BENCH_SUB_SPECTRA + 1)*sizeof(double), reps(50), [&]() {
+        sink = sink + averageVectors(subSpectra)[0];
+    });
+
+    // Trimmed spectrum kernels. addRescaledToCombined adds onto the same range each time, the steady state of a step
+    timeKernel("processedToRescaled", processedSpectrum.powers.size(), 5*sizeof(double), reps(200), [&]() {
+        sink = sink + dataProcessor.processedToRescaled(processedSpectrum).powers[0];
+    });
+    timeKernel("addRescaledToCombined", rescaledSpectrum.powers.size(), 9*sizeof(double) + 2*sizeof(int), reps(100), [&]() {
+        dataProcessor.addRescaledToCombined(rescaledSpectrum, combinedSpectrum);
+        sink = sink + combinedSpectrum.powers[0];
+    });
+    timeKernel("rebinCombinedSpectrum", combinedSpectrum.powers.size(), 3*sizeof(double) + 2*sizeof(int) + 4.0*sizeof(double)/BENCH_REBIN_WIDTH,
+               reps(100), [&]() {
+        sink = sink + dataProcessor.rebinCombinedSpectrum(combinedSpectrum, BENCH_REBIN_WIDTH, 1).powers[0];
+    });
+
+    // Rebinned spectrum kernels
+    timeKernel("updateExclusionLine", rebinnedBins, 9*sizeof(double), reps(2000), [&]() {
+        bayesFactors.updateExclusionLine(rebinnedSpectrum);
+        sink = sink + bayesFactors.exclusionLine.powers.back();
+    });
+    timeKernel("checkScore", rebinnedBins, 3*sizeof(double), reps(2000), [&]() {
+        sink = sink + decisionAgent.checkScore(activeExclusionLine);
+    });
+
+    std::cout << std::endl;
+}
+
+
+
+/**
+ * @brief Times a kernel and prints one row of the table. The kernel runs once untimed to warm the caches and allocator, then repetitions
+ * times individually timed.
+ *
+ * @param name - Kernel name for the table
+ * @param bins - Bins the kernel works through per call
+ * @param bytesPerBin - Bytes of input and output vectors per bin, for GB/s
+ * @param repetitions - Timed calls
+ * @param kernel - Runs the kernel once
+ */
+void timeKernel(std::string const& name, size_t bins, double bytesPerBin, int repetitions, std::function<void()> const& kernel) {
+    kernel();
+
+    std::vector<double> times(repetitions);
+    for (int rep = 0; rep < repetitions; rep++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        kernel();
+        times[rep] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::sort(times.begin(), times.end());
+
+    double median = times[times.size()/2];
+    double best = times.front();
+
+    fprintf(stdout, "   %-24s %10zu %14.3f %14.3f %10.2f\n", name.c_str(), bins, median/bins*1e9, best/bins*1e9, bins*bytesPerBin/median/1e9);
+}
+
+
+
+/**
+ * @brief Gaussian noise of standard deviation noise around level, kept positive so baselines and SNRs can be divided by.
+ *
+ */
+std::vector<double> syntheticSpectrum(size_t bins, double level, double noise, std::mt19937& generator) {
+    std::normal_distribution<double> distribution(level, noise);
+
+    std::vector<double> spectrum(bins);
+    for (size_t i = 0; i < bins; i++) {
+        double value = distribution(generator);
+        spectrum[i] = (value > 0.01*level) ? value : 0.01*level;
+    }
+    return spectrum;
+}
+
+
+
+/**
+ * @brief Frequency axis centered on DC with the given bin spacing, in MHz like the acquired spectra.
+ *
+ */
+std::vector<double> syntheticAxis(size_t bins, double resolution) {
+    std::vector<double> axis(bins);
+    for (size_t i = 0; i < bins; i++) {
+        axis[i] = ((double)i - (double)(bins/2))*resolution;
+    }
+    return axis;
+}
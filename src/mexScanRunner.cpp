@@ -14,6 +14,9 @@
 #include "mex.hpp"
 #include "mexAdapter.hpp"
 
+// Largest difference (MHz) between the requested center frequency and the kept runner's for the call to count as the next step
+#define MEX_FREQUENCY_TOLERANCE (1e-6)
+
 /**
  * @brief
  * 
@@ -27,24 +30,54 @@ public:
         checkArguments(outputs, inputs);
 
         // Unpack scan parameters into struct
-        ScanParameters scanParameters = readInput(inputs[0]);
+        json inputParams = readInput(inputs[0]);
+        ScanParameters scanParameters = unpackScanParameters(inputParams);
         bool fullSave = readBooleanInput(inputs[1]);
 
-        // Begin scanning
-        ScanRunner scanRunner(scanParameters);
+        // Everything but the center frequency has to match for the kept runner to be reused
+        json runnerKey = inputParams;
+        runnerKey["dataParams"].erase("trueCenterFreq");
+
+        // The last call's state may still be queued for writing
+        if (scanRunner) {
+            scanRunner->waitForSaves();
+        }
 
         std::ifstream file(scanParameters.topLevelParameters.statePath + "scanInfo.json");
-        if (file.is_open()) {
-            file.close();
-            scanRunner.loadStateAndStep();
+        bool stateExists = file.is_open();
+        file.close();
+
+        // The kept runner was already stepped in memory at the end of the last call. Reuse it if this call continues that scan, otherwise 
+        // (new parameters, cleared state or a jump in frequency) start over from the state on disk
+        bool continuesScan = scanRunner && stateExists && (runnerKey == scanRunnerKey) && 
+            std::abs(scanRunner->scanParams.dataParameters.trueCenterFreq - scanParameters.dataParameters.trueCenterFreq) < MEX_FREQUENCY_TOLERANCE;
+
+        try {
+            if (continuesScan) {
+                scanRunner->scanParams.dataParameters.trueCenterFreq = scanParameters.dataParameters.trueCenterFreq;
+            }
+            else {
+                scanRunner.reset();
+                scanRunner.reset(new ScanRunner(scanParameters));
+                scanRunnerKey = runnerKey;
+
+                if (stateExists) {
+                    scanRunner->loadStateAndStep();
+                }
+            }
+
+            // Begin scanning
+            scanRunner->runSteps(1, scanParameters.dataParameters.stepSize, fullSave ? 1 : 0);
+
+            // The caller may read back the saved data or delete the state folder as soon as this returns, so nothing may still be in flight
+            scanRunner->waitForSaves();
+        }
+        catch (...) {
+            // Don't reuse a runner that failed part way through a step
+            scanRunner.reset();
+            throw;
         }
-        else { file.close(); }
-    
-        scanRunner.acquireData();
 
-        if (fullSave) { scanRunner.saveData(); }
-        scanRunner.saveState();
-        
 
         // Return performance data via JSON string
         std::string jsonString = performanceToJson().dump();
@@ -56,8 +89,13 @@ public:
         
 
 private:
-    ScanParameters readInput(matlab::data::CharArray const& inputJson) {
-        return unpackScanParameters(json::parse(inputJson));
+    // Kept across calls while the MEX file stays loaded, along with the parameters it was built with
+    std::unique_ptr<ScanRunner> scanRunner;
+    json scanRunnerKey;
+
+
+    json readInput(matlab::data::CharArray const& inputJson) {
+        return json::parse(inputJson);
     }
 
 
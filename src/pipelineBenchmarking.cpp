@@ -0,0 +1,250 @@
+/**
+ * @file pipelineBenchmarking.cpp
+ * @author your name (you@domain.com)
+ * @brief End to end throughput of the acquireData thread graph. The simulated board synthesizes (or replays a recording) with no rate limit,
+ *        so the pipeline runs as fast as its slowest stage. Sweeps the RBW, subSpectraAveragingNumber and the FFT thread count and reports the
+ *        sustained sample rate, the real time factor, per stage utilization and the queue high-watermarks. Built as cpp_pipeline_bench, only
+ *        with SIMULATED_ATS.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+#define BENCH_SAMPLE_RATE   (32e6)
+#define BENCH_SECONDS       (0.5)   // Of data per run
+
+/**
+ * @brief One configuration of the sweep and what it measured.
+ *
+ */
+struct PipelineBenchResult {
+    double RBW;
+    int subSpectraAveragingNumber;
+    int fftThreads;
+
+    double wallTime;
+    double samplesPerSecond;
+    double realTimeFactor;
+    double utilization[NUM_TIMERS];     // Busy time over wall time per thread of the stage
+    size_t maxDepth[NUM_QUEUES];
+};
+
+void prepareGeometry(std::string const& scanDir, double sampleRate, double RBW);
+ScanParameters benchParameters(std::string const& scanDir, double sampleRate, double RBW, double seconds);
+PipelineBenchResult runConfiguration(ScanRunner& runner, ScanParameters const& scanParams);
+void printResults(std::vector<PipelineBenchResult> const& results);
+json resultsToJson(std::vector<PipelineBenchResult> const& results, double sampleRate, double seconds, std::string const& replayPath);
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: cpp_pipeline_bench scanDir [sampleRate] [seconds] [replayFile]" << std::endl;
+        std::cout << "   Overwrites the vis/ and baseline/ files of scanDir, which also needs state/ and save/ folders" << std::endl;
+        std::cout << "   A replayFile sets the sample rate and the RBW itself" << std::endl;
+        return 1;
+    }
+    std::string scanDir = argv[1];
+    double sampleRate = (argc > 2) ? std::atof(argv[2]) : BENCH_SAMPLE_RATE;
+    double seconds = (argc > 3) ? std::atof(argv[3]) : BENCH_SECONDS;
+    std::string replayPath = (argc > 4) ? argv[4] : "";
+
+    std::vector<double> RBWs = {2000, 1000, 500};
+    std::vector<int> subSpectraAveragingNumbers = {10, 20, 50};
+    std::vector<int> fftThreadCounts = {1, 2, 4};
+
+    // A recording fixes the sample rate and buffer size, so only its own RBW can be swept
+    if (!replayPath.empty()) {
+        RawStreamReplay replay;
+        replay.open(replayPath);
+        sampleRate = replay.getHeader().sampleRate;
+        RBWs = {sampleRate/replay.getHeader().samplesPerBuffer};
+    }
+
+    std::vector<PipelineBenchResult> results;
+    for (double RBW : RBWs) {
+        prepareGeometry(scanDir, sampleRate, RBW);
+
+        for (int subSpectraAveragingNumber : subSpectraAveragingNumbers) {
+            for (int fftThreads : fftThreadCounts) {
+                ScanParameters scanParams = benchParameters(scanDir, sampleRate, RBW, seconds);
+                scanParams.dataParameters.subSpectraAveragingNumber = subSpectraAveragingNumber;
+                scanParams.pipelineParameters.fftThreads = fftThreads;
+                scanParams.pipelineParameters.replayPath = replayPath;
+
+                ScanRunner runner(scanParams);
+
+                // The baseline comes from this geometry's own calibration, done by the first runner
+                if (readVector(scanDir + "baseline/baseline.csv").empty()) {
+                    runner.refreshBaselineAndBadBins();
+                }
+
+                results.push_back(runConfiguration(runner, scanParams));
+            }
+        }
+    }
+
+    printResults(results);
+    std::ofstream fileStream(scanDir + "pipelineBench.json");
+    fileStream << resultsToJson(results, sampleRate, seconds, replayPath).dump();
+    fileStream.close();
+}
+
+
+
+/**
+ * @brief Writes a flat SNR for the geometry to scanDir/vis/ and removes the baseline and bad bins of any other geometry, so the first
+ * runner of the geometry calibrates them again.
+ *
+ * @param scanDir - Scan folder the runners are pointed at
+ * @param sampleRate - Sample rate (Hz)
+ * @param RBW - Resolution bandwidth (Hz), which sets the number of bins
+ */
+void prepareGeometry(std::string const& scanDir, double sampleRate, double RBW) {
+    int bins = (int)(sampleRate/RBW);
+
+    std::vector<double> freq(bins);
+    for (int i = 0; i < bins; i++) {
+        freq[i] = (i - bins/2)*RBW/1e6;
+    }
+    saveVector(std::vector<double>(bins, 1.0), scanDir + "vis/visSmoothed.csv");
+    saveVector(freq, scanDir + "vis/visFreq.csv");
+
+    std::remove((scanDir + "baseline/baseline.csv").c_str());
+    std::remove((scanDir + "baseline/badBins.csv").c_str());
+}
+
+
+
+/**
+ * @brief Scan parameters for a fixed horizon acquisition of the given length. Decision making is off so every run acquires all of it.
+ *
+ */
+ScanParameters benchParameters(std::string const& scanDir, double sampleRate, double RBW, double seconds) {
+    ScanParameters scanParams;
+
+    scanParams.topLevelParameters.decisionMaking = false;
+    scanParams.topLevelParameters.targetCoupling = 1;
+    scanParams.topLevelParameters.baselinePath = scanDir + "baseline/";
+    scanParams.topLevelParameters.statePath = scanDir + "state/";
+    scanParams.topLevelParameters.savePath = scanDir + "save/";
+    scanParams.topLevelParameters.visPath = scanDir + "vis/";
+    scanParams.topLevelParameters.wisdomPath = scanDir + "wisdom/";
+
+    scanParams.dataParameters.maxIntegrationTime = seconds;
+    scanParams.dataParameters.minIntegrationTime = seconds;
+    scanParams.dataParameters.sampleRate = sampleRate;
+    scanParams.dataParameters.RBW = RBW;
+    scanParams.dataParameters.trueCenterFreq = 5e3;
+    scanParams.dataParameters.stepSize = 0.1;
+
+    scanParams.filterParameters.cutoffFrequency = 10e3;
+    scanParams.filterParameters.poleNumber = 3;
+    scanParams.filterParameters.stopbandAttenuation = 15;
+
+    // No rate limit on the source
+    scanParams.pipelineParameters.replaySpeed = 0;
+
+    // Enough FFT pool to back the queue lanes of the largest fftThreads in the sweep
+    scanParams.pipelineParameters.fftPoolSize = 128;
+
+    return scanParams;
+}
+
+
+
+/**
+ * @brief Runs one untimed acquisition to warm the pools, plans and caches, then times one more.
+ *
+ * @param runner - Runner built from scanParams
+ * @param scanParams - Parameters of the runner, for the sweep values and the nominal sample rate
+ * @return PipelineBenchResult - The timed acquisition
+ */
+PipelineBenchResult runConfiguration(ScanRunner& runner, ScanParameters const& scanParams) {
+    MetricCounter& acquiredSamples = metricsRegistry().counter("acquisition_samples_total", "Samples per channel handed to the pipeline");
+
+    runner.acquireData();
+
+    resetTimers();
+    resetMetrics();
+    std::uint64_t samplesBefore = acquiredSamples.get();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    runner.acquireData();
+    double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    PipelineBenchResult result;
+    result.RBW = scanParams.dataParameters.RBW;
+    result.subSpectraAveragingNumber = scanParams.dataParameters.subSpectraAveragingNumber;
+    result.fftThreads = scanParams.pipelineParameters.fftThreads;
+
+    result.wallTime = wallTime;
+    result.samplesPerSecond = (acquiredSamples.get() - samplesBefore)/wallTime;
+    result.realTimeFactor = result.samplesPerSecond/scanParams.dataParameters.sampleRate;
+
+    for (int n = 0; n < NUM_TIMERS; n++) {
+        int threads = (n == TIMER_FFT) ? result.fftThreads : 1;
+        result.utilization[n] = getTimerStats(n).total/wallTime/threads;
+    }
+    for (int n = 0; n < NUM_QUEUES; n++) {
+        result.maxDepth[n] = getQueueStats(n).maxDepth;
+    }
+
+    return result;
+}
+
+
+
+void printResults(std::vector<PipelineBenchResult> const& results) {
+    fprintf(stdout, "\n********** PIPELINE THROUGHPUT **********\n");
+    fprintf(stdout, "   Utilization is busy time over wall time per thread of the stage, depth is the high-watermark of each queue\n\n");
+
+    fprintf(stdout, "   %6s %5s %4s %9s %12s %8s %6s %6s %6s %6s %6s %6s %5s %5s %5s %5s %5s\n", "RBW", "AVG", "FFTS", "WALL (s)", "SAMPLES/s",
+            "x REAL", "ACQ", "FFT", "MAG", "AVER", "PROC", "DEC", "RAW", "FFT", "MAG", "PROC", "DEC");
+    for (PipelineBenchResult const& result : results) {
+        fprintf(stdout, "   %6.0f %5d %4d %9.3f %12.4g %8.2f %5.0f%% %5.0f%% %5.0f%% %5.0f%% %5.0f%% %5.0f%% %5zu %5zu %5zu %5zu %5zu\n",
+                result.RBW, result.subSpectraAveragingNumber, result.fftThreads, result.wallTime, result.samplesPerSecond, result.realTimeFactor,
+                result.utilization[TIMER_ACQUISITION]*100, result.utilization[TIMER_FFT]*100, result.utilization[TIMER_MAG]*100,
+                result.utilization[TIMER_AVERAGE]*100, result.utilization[TIMER_PROCESS]*100, result.utilization[TIMER_DECISION]*100,
+                result.maxDepth[QUEUE_RAW], result.maxDepth[QUEUE_FFT], result.maxDepth[QUEUE_MAG], result.maxDepth[QUEUE_PROC],
+                result.maxDepth[QUEUE_DECISION]);
+    }
+
+    fprintf(stdout, "*********************************\n\n");
+}
+
+
+
+json resultsToJson(std::vector<PipelineBenchResult> const& results, double sampleRate, double seconds, std::string const& replayPath) {
+    const char* stageNames[] = {"acquisition", "fft", "magnitude", "averaging", "processing", "decision", "save", "step"};
+    const char* queueNames[] = {"raw", "fft", "magnitude", "processing", "decision"};
+
+    json benchmark;
+    benchmark["sampleRate"] = sampleRate;
+    benchmark["seconds"] = seconds;
+    benchmark["source"] = replayPath.empty() ? "synthetic" : replayPath;
+
+    json runs = json::array();
+    for (PipelineBenchResult const& result : results) {
+        json run;
+        run["RBW"] = result.RBW;
+        run["subSpectraAveragingNumber"] = result.subSpectraAveragingNumber;
+        run["fftThreads"] = result.fftThreads;
+        run["wallTime"] = result.wallTime;
+        run["samplesPerSecond"] = result.samplesPerSecond;
+        run["realTimeFactor"] = result.realTimeFactor;
+
+        for (int n = 0; n < NUM_TIMERS; n++) {
+            run["utilization"][stageNames[n]] = result.utilization[n];
+        }
+        for (int n = 0; n < NUM_QUEUES; n++) {
+            run["maxQueueDepth"][queueNames[n]] = result.maxDepth[n];
+        }
+        runs.push_back(run);
+    }
+    benchmark["runs"] = runs;
+
+    return benchmark;
+}
@@ -22,12 +22,22 @@
  * @brief Construct a new Scan Runner object. This constructor initializes the PSGs, Alazar card, FFTW, and DataProcessor.
  * 
  */
-ScanRunner::ScanRunner(ScanParameters scanParams) : alazarCard(1, 1), scanParams(scanParams) {
+ScanRunner::ScanRunner(ScanParameters scanParams) : alazarCard(1, 1), scanParams(scanParams), rawRecordingCount(0), stepsStarted(0), savesSinceSnapshot(0) {
     // Set up member classes
     initAlazarCard();
     initFFTW();
     initProcessor();
     initDecisionAgent();
+
+    stateSaver.start();
+
+    // Clears the trace of any earlier runner, or turns tracing off
+    startTrace(scanParams.pipelineParameters.traceCapacity > 0 ? scanParams.pipelineParameters.traceCapacity : 0);
+
+    if (!scanParams.pipelineParameters.metricsPath.empty()) {
+        metricsExporter.start(metricsRegistry(), scanParams.pipelineParameters.metricsPath, scanParams.pipelineParameters.metricsFormat, 
+                              scanParams.pipelineParameters.metricsInterval);
+    }
 }
 
 
@@ -37,11 +47,29 @@ ScanRunner::ScanRunner(ScanParameters scanParams) : alazarCard(1, 1), scanParams
  * 
  */
 ScanRunner::~ScanRunner() {
+    // Finish writing any queued state and data
+    stateSaver.stop();
+
+    // Last export, with the final counts
+    metricsExporter.stop();
+
+    if (traceEnabled() && !scanParams.pipelineParameters.tracePath.empty()) {
+        saveChromeTrace(scanParams.pipelineParameters.tracePath + "trace_" + getDateTimeString() + ".json");
+    }
+
     // Save FFTW wisdom
     fftw_export_wisdom_to_filename((scanParams.topLevelParameters.wisdomPath + "fftw_wisdom.txt").c_str());
+#if SINGLE_PRECISION_PIPELINE
+    fftwf_export_wisdom_to_filename((scanParams.topLevelParameters.wisdomPath + "fftwf_wisdom.txt").c_str());
+#endif
 
     // Free FFTW memory
     fftw_destroy_plan(fftwPlan);
+    fftw_destroy_plan(fftwBatchPlan);
+#if SINGLE_PRECISION_PIPELINE
+    fftwf_destroy_plan(pipelinePlan);
+    fftwf_destroy_plan(pipelineBatchPlan);
+#endif
 }
 
 
@@ -76,20 +104,47 @@ void ScanRunner::initFFTW() {
     else {
         std::cout << "Failed to import FFTW wisdom from file." << std::endl;
     }
+#if SINGLE_PRECISION_PIPELINE
+    fftwf_import_wisdom_from_filename((scanParams.topLevelParameters.wisdomPath + "fftwf_wisdom.txt").c_str());
+#endif
 
     // Create an FFTW plan
     int N = (int)alazarCard.acquisitionParams.samplesPerBuffer;
 
-    std::cout << "Creating plan for N = " << std::to_string(N) << std::endl;
+    std::cout << "Creating plans for N = " << std::to_string(N) << std::endl;
 
     fftw_complex* fftwInput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * N));
     fftw_complex* fftwOutput = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * N));
     fftwPlan = fftw_plan_dft_1d(N, fftwInput, fftwOutput, FFTW_FORWARD, FFTW_MEASURE);
 
-    std::cout << "Plan created!" << std::endl;
-
     fftw_free(fftwInput);
     fftw_free(fftwOutput);
+
+    // Batched plan for fftBatch contiguous buffers, used by the pipeline and the calibration
+    fftBatch = scanParams.pipelineParameters.fftBatch > 1 ? scanParams.pipelineParameters.fftBatch : 1;
+    fftwBatchPlan = planFFTBatch(N, fftBatch, FFTW_MEASURE);
+
+    // The streaming pipeline gets its own float plans in single precision. Calibration keeps the double ones
+#if SINGLE_PRECISION_PIPELINE
+    fftwf_complex* fftwfInput = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * N));
+    fftwf_complex* fftwfOutput = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * N));
+    pipelinePlan = fftwf_plan_dft_1d(N, fftwfInput, fftwfOutput, FFTW_FORWARD, FFTW_MEASURE);
+    fftwf_free(fftwfInput);
+    fftwf_free(fftwfOutput);
+
+    pipelineBatchPlan = planFFTBatchFloat(N, fftBatch, FFTW_MEASURE);
+#else
+    pipelinePlan = fftwPlan;
+    pipelineBatchPlan = fftwBatchPlan;
+#endif
+
+    std::cout << "Plan created!" << std::endl;
+
+    // Pipeline blocks hold one batch each. Keep roughly the same number of buffers in flight whatever the batch size
+    size_t acquisitionBlocks = (ACQUISITION_POOL_SIZE + fftBatch - 1)/fftBatch;
+    size_t fftBlocks = (scanParams.pipelineParameters.fftPoolSize + fftBatch - 1)/fftBatch;
+    acquisitionPool.configure((size_t)N*fftBatch, acquisitionBlocks > 2 ? acquisitionBlocks : 2);
+    fftPool.configure((size_t)N*fftBatch, fftBlocks > 2 ? fftBlocks : 2);
 }
 
 
@@ -116,10 +171,12 @@ void ScanRunner::initProcessor() {
     else {
         std::cout << "Failed to import bad bins from file." << std::endl;
     }
+    badBinsGauge().set((double)dataProcessor.badBins.size());
 
 
     // Try to import baseline if available
     dataProcessor.currentBaseline = readVector(scanParams.topLevelParameters.baselinePath + "baseline.csv");
+    calibratedBaseline = dataProcessor.currentBaseline;
 }
 
 
@@ -148,26 +205,49 @@ void ScanRunner::initDecisionAgent(){
  * coeffSumB - vector of coefficients in the quadratic formula for the 90% excluded coupling strength
  * 
  * steps:
- *  1. Load the exclusionLine, coeffSumA, and coeffSumB from the previous scan
- *  2. Load the freqRes, statIndex, and cutoffIndex from the previous scan using the json file
- *  3. Determine the step size via previousCenterFreq - newCenterFreq
- *  4. Call the step function with the step size
+ *  1. Load the exclusionLine, coeffSumA, coeffSumB, freqRes, startIndex and cutoffIndex from the state journal (StateJournal). State paths 
+ *     written before the journal existed are loaded from the exclusionLine, coeffSumA and coeffSumB CSVs and the json file instead
+ *  2. Determine the step size via previousCenterFreq - newCenterFreq
+ *  3. Call the step function with the step size
  */
 void ScanRunner::loadStateAndStep() {
-    // Load the exclusion line, coeffSumA, and coeffSumB from the previous scan
-    bayesFactors.exclusionLine = readSpectrum(scanParams.topLevelParameters.statePath + "exclusionLine.csv");
-    bayesFactors.coeffSumA = readVector(scanParams.topLevelParameters.statePath + "coeffSumA.csv");
-    bayesFactors.coeffSumB = readVector(scanParams.topLevelParameters.statePath + "coeffSumB.csv");
-
-    // Load the freqRes, statIndex, and cutoffIndex from the previous scan using the json file
-    std::string jsonFilename = scanParams.topLevelParameters.statePath + "scanInfo.json";
-    std::ifstream jsonFile(jsonFilename);
-    json scanInfo;
-    jsonFile >> scanInfo;
+    // The files may still be queued for writing by this runner
+    stateSaver.flush();
+
+    bool fromJournal = StateJournal::exists(scanParams.topLevelParameters.statePath);
+    if (fromJournal) {
+        StateSnapshot state = StateJournal::load(scanParams.topLevelParameters.statePath);
+
+        bayesFactors.exclusionLine = state.exclusionLine;
+        bayesFactors.coeffSumA = state.coeffSumA;
+        bayesFactors.coeffSumB = state.coeffSumB;
+        bayesFactors.freqRes = state.freqRes;
+        bayesFactors.startIndex = state.startIndex;
+        bayesFactors.cutoffIndex = state.cutoffIndex;
+        bayesFactors.baseIndex = (int)state.baseIndex;
+    }
+    else {
+        // Load the exclusion line, coeffSumA, and coeffSumB from the previous scan
+        bayesFactors.exclusionLine = readSpectrum(scanParams.topLevelParameters.statePath + "exclusionLine.csv");
+        bayesFactors.coeffSumA = readVector(scanParams.topLevelParameters.statePath + "coeffSumA.csv");
+        bayesFactors.coeffSumB = readVector(scanParams.topLevelParameters.statePath + "coeffSumB.csv");
+
+        // Load the freqRes, statIndex, and cutoffIndex from the previous scan using the json file
+        std::string jsonFilename = scanParams.topLevelParameters.statePath + "scanInfo.json";
+        std::ifstream jsonFile(jsonFilename);
+        json scanInfo;
+        jsonFile >> scanInfo;
+
+        bayesFactors.freqRes = scanInfo["freqRes"];
+        bayesFactors.startIndex = scanInfo["startIndex"];
+        bayesFactors.cutoffIndex = scanInfo["cutoffIndex"];
+        bayesFactors.baseIndex = 0;
+    }
+    bayesFactors.finalizedBins = Spectrum();
 
-    bayesFactors.freqRes = scanInfo["freqRes"];
-    bayesFactors.startIndex = scanInfo["startIndex"];
-    bayesFactors.cutoffIndex = scanInfo["cutoffIndex"];
+    // Everything loaded is already on disk, the next save only has to journal what changes from here. A CSV state gets its first snapshot
+    bayesFactors.markClean();
+    savesSinceSnapshot = fromJournal ? 1 : 0;
 
     // Call the step function with the step size
     if (scanParams.dataParameters.stepSize != 0){
@@ -175,21 +255,58 @@ void ScanRunner::loadStateAndStep() {
     }   
 }
 
+/**
+ * @brief Saves the exclusion line, coeffSumA, coeffSumB and scanInfo.json to the state path. Only the bins of the active window that changed 
+ * since the last save are copied and appended to the state journal, with the window compacted into a snapshot every 
+ * JOURNAL_SNAPSHOT_INTERVAL saves. Bins that left the window since the last save are handed over to the journal's segment file. The writing 
+ * is done by the saver thread, so the files may lag behind until waitForSaves() returns.
+ * 
+ * @param prefix - Prepended to scanInfo.json
+ * @param precision - Significant digits of freqRes and previousCenterFreq in scanInfo.json
+ */
 void ScanRunner::saveState(std::string prefix, int precision) {
-    // Save the exclusion line, coeffSumA, and coeffSumB
-    saveSpectrum(bayesFactors.exclusionLine, scanParams.topLevelParameters.statePath + "exclusionLine.csv");
-    saveVector(bayesFactors.coeffSumA, scanParams.topLevelParameters.statePath + "coeffSumA.csv");
-    saveVector(bayesFactors.coeffSumB, scanParams.topLevelParameters.statePath + "coeffSumB.csv");
-
-    // Save the freqRes, statIndex, and cutoffIndex to a json file
-    json scanInfo;
-    scanInfo["freqRes"] = formatWithPrecision(bayesFactors.freqRes, precision);
-    scanInfo["startIndex"] = bayesFactors.startIndex;
-    scanInfo["cutoffIndex"] = bayesFactors.cutoffIndex;
-    scanInfo["previousCenterFreq"] = formatWithPrecision(scanParams.dataParameters.trueCenterFreq, precision);
-
-    std::ofstream jsonFile(scanParams.topLevelParameters.statePath + prefix + "scanInfo.json");
-    jsonFile << scanInfo;
+    bool compact = (savesSinceSnapshot % JOURNAL_SNAPSHOT_INTERVAL == 0);
+    savesSinceSnapshot = compact ? 1 : savesSinceSnapshot + 1;
+
+    // Absolute bins, the window holds [baseIndex, totalBins)
+    size_t baseIndex = (size_t)bayesFactors.baseIndex;
+    size_t totalBins = (size_t)bayesFactors.totalBins();
+    size_t firstBin = compact ? baseIndex : (size_t)bayesFactors.dirtyIndex;
+    firstBin = (firstBin > baseIndex) ? firstBin : baseIndex;
+    firstBin = (firstBin < totalBins) ? firstBin : totalBins;
+    size_t offset = firstBin - baseIndex;
+
+    StateSnapshot snapshot;
+    snapshot.exclusionLine.powers.assign(bayesFactors.exclusionLine.powers.begin() + offset, bayesFactors.exclusionLine.powers.end());
+    snapshot.exclusionLine.freqAxis.assign(bayesFactors.exclusionLine.freqAxis.begin() + offset, bayesFactors.exclusionLine.freqAxis.end());
+    snapshot.coeffSumA.assign(bayesFactors.coeffSumA.begin() + offset, bayesFactors.coeffSumA.end());
+    snapshot.coeffSumB.assign(bayesFactors.coeffSumB.begin() + offset, bayesFactors.coeffSumB.end());
+    snapshot.finalizedBins = std::move(bayesFactors.finalizedBins);
+    bayesFactors.finalizedBins = Spectrum();
+    snapshot.firstBin = firstBin;
+    snapshot.totalBins = totalBins;
+    snapshot.baseIndex = baseIndex;
+    snapshot.compact = compact;
+    snapshot.freqRes = bayesFactors.freqRes;
+    snapshot.startIndex = bayesFactors.startIndex;
+    snapshot.cutoffIndex = bayesFactors.cutoffIndex;
+    snapshot.trueCenterFreq = scanParams.dataParameters.trueCenterFreq;
+    snapshot.statePath = scanParams.topLevelParameters.statePath;
+    snapshot.prefix = prefix;
+    snapshot.precision = precision;
+
+    bayesFactors.markClean();
+    stateSaver.submit(std::move(snapshot));
+}
+
+
+
+/**
+ * @brief Blocks until everything passed to saveState and saveData so far is on disk.
+ * 
+ */
+void ScanRunner::waitForSaves() {
+    stateSaver.flush();
 }
 
 
@@ -198,93 +315,191 @@ void ScanRunner::saveState(std::string prefix, int precision) {
  * 
  */
 void ScanRunner::acquireData() {
+    PipelineContext& pipeline = pipelines[0];
+
+    startPipeline(pipeline, scanParams.dataParameters.trueCenterFreq);
+    startDecisions(pipeline);
+
+    finishAcquisition(pipeline);
+    finishPipeline(pipeline);
+}
+
+
+
+/**
+ * @brief Starts every stage of a step except decision making on the pipeline's workers: acquisition, FFT workers, spectrum threads and
+ * processing. The pipeline gets a fresh copy of the DataProcessor with an empty running average, the calibrated baseline and a cleared filter.
+ * 
+ * @param pipeline - Context to run the step in. Must not be running
+ * @param trueCenterFreq - Center frequency of the step (MHz)
+ */
+void ScanRunner::startPipeline(PipelineContext& pipeline, double trueCenterFreq) {
     int N = (int)alazarCard.acquisitionParams.samplesPerBuffer;
 
-    // Set up shared data
-    ThreadSafeQueue<fftw_complex*> rawQueue;
-    ThreadSafeQueue<fftw_complex*> fftQueue;
-    ThreadSafeQueue<std::vector<double>> magQueue;
-    ThreadSafeQueue<Spectrum> procQueue;
-    ThreadSafeQueue<CombinedSpectrum> decisionQueue;
+#if SIMULATED_ATS
+    // Keep the simulated axion line fixed in absolute frequency as the scan steps
+    alazarCard.simParams.centerFrequency = trueCenterFreq;
+
+    // Play back a recorded acquisition instead of synthesizing one
+    alazarCard.simParams.replayPath = scanParams.pipelineParameters.replayPath;
+    if (!scanParams.pipelineParameters.replayPath.empty()) {
+        alazarCard.simParams.realTime = (scanParams.pipelineParameters.replaySpeed > 0);
+        alazarCard.simParams.speed = scanParams.pipelineParameters.replaySpeed;
+    }
+#endif
 
-    std::atomic<bool> triggerEnd(false);
+    // Per step processing state. The baseline filter carries its state from one spectrum to the next
+    pipeline.dataProcessor = dataProcessor;
+    pipeline.dataProcessor.runningAverage.clear();
+    pipeline.dataProcessor.numSpectra = 0;
+    pipeline.dataProcessor.currentBaseline = calibratedBaseline;
+    pipeline.dataProcessor.chebyshevFilter.reset();
+    pipeline.trueCenterFreq = trueCenterFreq;
 
+    // Set up shared data
+    pipeline.triggerEnd = false;
+    pipeline.pipelineOverflow = false;
+
+    const PipelineParameters& pipe = scanParams.pipelineParameters;
+    int fftThreads = pipe.fftThreads > 1 ? pipe.fftThreads : 1;
+
+    // The raw and FFT queues hold pool blocks, their capacities are given in spectra
+    size_t rawQueueBlocks = (pipe.queueCapacity[QUEUE_RAW] + fftBatch - 1)/fftBatch;
+    size_t fftQueueBlocks = (pipe.queueCapacity[QUEUE_FFT] + fftBatch - 1)/fftBatch;
+
+    pipeline.rawQueue.reset(new LanedQueue<PooledBuffer>(fftThreads, rawQueueBlocks, pipe.queuePolicy[QUEUE_RAW], &pipeline.pipelineOverflow));
+    pipeline.fftQueue.reset(new LanedQueue<PooledBuffer>(fftThreads, fftQueueBlocks, pipe.queuePolicy[QUEUE_FFT], &pipeline.pipelineOverflow));
+    pipeline.magQueue.reset(new PipelineQueue<Spectrum>(pipe.queueCapacity[QUEUE_MAG], pipe.queuePolicy[QUEUE_MAG], &pipeline.pipelineOverflow));
+    pipeline.procQueue.reset(new PipelineQueue<Spectrum>(pipe.queueCapacity[QUEUE_PROC], pipe.queuePolicy[QUEUE_PROC], &pipeline.pipelineOverflow));
+    pipeline.decisionQueue.reset(new PipelineQueue<CombinedSpectrum>(pipe.queueCapacity[QUEUE_DECISION], pipe.queuePolicy[QUEUE_DECISION], &pipeline.pipelineOverflow));
+
+    // The magnitude thread waits on one lane while the other workers keep filling theirs. The FFT pool has to cover every lane slot, one 
+    // block per worker and one for the magnitude thread, otherwise a worker can wait on the pool for blocks that are never given back. 
+    // Every pipeline context needs that share, since a step waiting on its decision thread can hold all of it while the step before it drains
+    size_t contexts = sizeof(pipelines)/sizeof(pipelines[0]);
+    size_t fftBlocksNeeded = contexts*(fftThreads*(pipeline.fftQueue->lane(0).getCapacity() + 1) + 1);
+    if (fftPool.getCapacity() < fftBlocksNeeded) {
+        throw std::runtime_error("Error: the FFT queues need " + std::to_string(fftBlocksNeeded*fftBatch) + " spectra of FFT pool, fftPoolSize is " +
+            std::to_string(pipe.fftPoolSize) + ". Raise fftPoolSize or lower fftThreads or the FFT queue capacity\n");
+    }
 
-    // Begin the threads
-    std::thread acquisitionThread(&ATS::AcquireDataMultithreadedContinuous, &alazarCard, std::ref(rawQueue), std::ref(triggerEnd));
-    std::thread fftThread(fftThread, fftwPlan, N, std::ref(rawQueue), std::ref(fftQueue));
-    std::thread magnitudeThread(magnitudeThread, N, std::ref(dataProcessor), std::ref(fftQueue), std::ref(magQueue));
-    std::thread averagingThread(averagingThread, std::ref(dataProcessor), std::ref(scanParams.dataParameters.trueCenterFreq), std::ref(magQueue), std::ref(procQueue), scanParams.dataParameters.subSpectraAveragingNumber);
-    std::thread processingThread(processingThread, std::ref(dataProcessor), std::ref(procQueue), std::ref(decisionQueue));
-    std::thread decisionMakingThread(decisionMakingThread, std::ref(bayesFactors), std::ref(decisionAgent), std::ref(decisionQueue), std::ref(triggerEnd));
 
+    // Record this acquisition's raw buffers if asked to
+    RawStreamRecorder* recorder = nullptr;
+    if (!pipe.recordPath.empty()) {
+        rawRecorder.start(pipe.recordPath + "raw_" + getDateTimeString() + "_" + std::to_string(rawRecordingCount++) + ".bin", alazarCard.acquisitionParams);
+        recorder = &rawRecorder;
+    }
 
-    // Wait for the threads to finish
-    acquisitionThread.join();
-    fftThread.join();
-    magnitudeThread.join();
-    averagingThread.join();
-    processingThread.join();
-    decisionMakingThread.join();
 
+    // Re-arm the workers with this step's scheduling settings
+    for (int role = 0; role < NUM_WORKER_ROLES; role++) {
+        WorkerSettings settings;
+        settings.affinityMask = pipe.workerAffinity[role];
+        settings.priority = pipe.workerPriority[role];
+        pipeline.workers.setRoleSettings(role, settings);
+    }
 
-    // Cleanup
-    reportPerformance();
+    // Begin the stages
+    pipeline.workers.run(WORKER_ACQUISITION, &Digitizer::AcquireDataMultithreadedContinuous, &alazarCard, std::ref(*pipeline.rawQueue), std::ref(acquisitionPool), std::ref(pipeline.triggerEnd), std::ref(pipeline.pipelineOverflow), recorder, stepsStarted++);
+    for (int i = 0; i < fftThreads; i++) {
+        pipeline.workers.run(WORKER_FFT, ::fftThread, pipelinePlan, pipelineBatchPlan, fftBatch, N, std::ref(pipeline.rawQueue->lane(i)), std::ref(pipeline.fftQueue->lane(i)), std::ref(fftPool));
+    }
+    if (pipe.fusedAccumulation) {
+        pipeline.workers.run(WORKER_SPECTRUM, ::accumulationThread, N, std::ref(pipeline.dataProcessor), pipeline.trueCenterFreq, std::ref(*pipeline.fftQueue), std::ref(*pipeline.procQueue), scanParams.dataParameters.subSpectraAveragingNumber);
+    }
+    else {
+        pipeline.workers.run(WORKER_SPECTRUM, ::magnitudeThread, N, std::ref(pipeline.dataProcessor), std::ref(*pipeline.fftQueue), std::ref(*pipeline.magQueue));
+        pipeline.workers.run(WORKER_SPECTRUM, ::averagingThread, std::ref(pipeline.dataProcessor), pipeline.trueCenterFreq, std::ref(*pipeline.magQueue), std::ref(*pipeline.procQueue), scanParams.dataParameters.subSpectraAveragingNumber);
+    }
+    pipeline.workers.run(WORKER_PROCESSING, ::processingThread, std::ref(pipeline.dataProcessor), std::ref(*pipeline.procQueue), std::ref(*pipeline.decisionQueue));
 }
 
 
 
 /**
- * @brief Saves any data available to the scanRunner to csv files to be plotted later in python.
+ * @brief Starts the decision thread of a step. It commits to bayesFactors, so a step's decisions may only start once the step before it has 
+ * finished and bayesFactors has been stepped to this step's center frequency. Until then its spectra wait in the decision queue.
  * 
+ * @param pipeline - Context started with startPipeline
  */
-void ScanRunner::saveData() {
-    // Save the data
-    std::vector<int> outliers = findOutliers(dataProcessor.runningAverage, 50, 4);
+void ScanRunner::startDecisions(PipelineContext& pipeline) {
+    pipeline.workers.run(WORKER_DECISION, ::decisionMakingThread, std::ref(bayesFactors), std::ref(decisionAgent), std::ref(*pipeline.decisionQueue), std::ref(pipeline.triggerEnd));
+}
 
-    std::vector<double> freq(alazarCard.acquisitionParams.samplesPerBuffer);
-    for (std::size_t i = 0; i < freq.size(); ++i) {
-        freq[i] = (static_cast<double>(i)-static_cast<double>(alazarCard.acquisitionParams.samplesPerBuffer)/2)
-                    *scanParams.dataParameters.sampleRate/alazarCard.acquisitionParams.samplesPerBuffer/1e6;
-    }
 
-    saveVector(freq, scanParams.topLevelParameters.savePath + "freq.csv");
-    saveVector(outliers, scanParams.topLevelParameters.savePath + "outliers.csv");
 
-    dataProcessor.updateBaseline();
-    saveVector(dataProcessor.currentBaseline, scanParams.topLevelParameters.savePath + "baseline.csv");
-    saveVector(dataProcessor.runningAverage, scanParams.topLevelParameters.savePath + "runningAverage.csv");
+/**
+ * @brief Waits for the step to stop acquiring, either at the fixed horizon or because the decision to end the step fired. The board is free 
+ * for the next step as soon as this returns.
+ * 
+ * @param pipeline - Context started with startPipeline
+ */
+void ScanRunner::finishAcquisition(PipelineContext& pipeline) {
+    pipeline.workers.wait(WORKER_ACQUISITION);
+    rawRecorder.stop();
+}
+
 
-    // saveSpectrum(savedData.rawSpectra[0], scanParams.topLevelParameters.savePath + "rawSpectrum.csv");
 
+/**
+ * @brief Waits for the rest of the step to drain through processing and decision making, then makes its DataProcessor the runner's (for 
+ * saveData) and reports the step's performance.
+ * 
+ * @param pipeline - Context that finishAcquisition was called on
+ */
+void ScanRunner::finishPipeline(PipelineContext& pipeline) {
+    // Wait for the stages to finish. The workers stay up for the next step
+    pipeline.workers.waitAll();
 
-    // Spectrum processedSpectrum, foo;
-    // std::tie(processedSpectrum, foo) = dataProcessor.rawToProcessed(savedData.rawSpectra[0]);
-    // trimSpectrum(processedSpectrum, 0.1);
-    // saveSpectrum(processedSpectrum, scanParams.topLevelParameters.savePath + "processedSpectrum.csv");
+    dataProcessor = pipeline.dataProcessor;
 
 
-    // dataProcessor.trimSNRtoMatch(processedSpectrum);
-    // Spectrum rescaledSpectrum = dataProcessor.processedToRescaled(processedSpectrum);
+    // Cleanup
+    recordQueueStats(QUEUE_RAW, pipeline.rawQueue->getStats());
+    recordQueueStats(QUEUE_FFT, pipeline.fftQueue->getStats());
+    recordQueueStats(QUEUE_MAG, pipeline.magQueue->getStats());
+    recordQueueStats(QUEUE_PROC, pipeline.procQueue->getStats());
+    recordQueueStats(QUEUE_DECISION, pipeline.decisionQueue->getStats());
 
+    metricsRegistry().counter("steps_total", "Acquisitions that have finished processing").add();
+    metricsRegistry().gauge("center_frequency_mhz", "Center frequency of the last finished step").set(pipeline.trueCenterFreq);
 
-    // saveCombinedSpectrum(savedData.combinedSpectrum, scanParams.topLevelParameters.savePath + "combinedSpectrum.csv");
-    saveSpectrum(bayesFactors.exclusionLine, scanParams.topLevelParameters.savePath + "exclusionLine.csv");
+    pipeline.rawQueue.reset();
+    pipeline.fftQueue.reset();
+    pipeline.magQueue.reset();
+    pipeline.procQueue.reset();
+    pipeline.decisionQueue.reset();
 
-    std::string exclusionLineFilename = scanParams.topLevelParameters.savePath + "data/exclusionLine_";
-    std::string scanInfoFilename = scanParams.topLevelParameters.savePath + "metrics/scanInfo_";
+    reportPerformance();
+}
 
-    if (scanParams.topLevelParameters.decisionMaking){
-        exclusionLineFilename += "dynamic_";
-        scanInfoFilename += "dynamic_";
-    }
 
-    exclusionLineFilename += getDateTimeString() + ".csv";
-    scanInfoFilename += getDateTimeString() + ".csv";
 
-    saveSpectrum(bayesFactors.exclusionLine, exclusionLineFilename);
-    saveVector(getMetric(ACQUIRED_SPECTRA), scanInfoFilename);
-    // Add in scan info saving
+/**
+ * @brief Saves any data available to the scanRunner to csv files to be plotted later in python. Like saveState, the data is copied and
+ * written by the saver thread, which also works out the baseline of the step's running average.
+ * 
+ */
+void ScanRunner::saveData() {
+    DataSnapshot snapshot;
+    snapshot.runningAverage = dataProcessor.runningAverage;
+    snapshot.baselineFilter = dataProcessor.chebyshevFilter.getParams();
+
+    // The saver reads the bins already spilled to the state journal back, the rest of the exclusion line is still held here
+    snapshot.statePath = scanParams.topLevelParameters.statePath;
+    snapshot.segmentBins = bayesFactors.baseIndex - bayesFactors.finalizedBins.powers.size();
+    snapshot.exclusionLine = bayesFactors.finalizedBins;
+    snapshot.exclusionLine.powers.insert(snapshot.exclusionLine.powers.end(), bayesFactors.exclusionLine.powers.begin(), bayesFactors.exclusionLine.powers.end());
+    snapshot.exclusionLine.freqAxis.insert(snapshot.exclusionLine.freqAxis.end(), bayesFactors.exclusionLine.freqAxis.begin(), bayesFactors.exclusionLine.freqAxis.end());
+    snapshot.acquiredSpectra = getMetric(ACQUIRED_SPECTRA);
+    snapshot.samplesPerBuffer = alazarCard.acquisitionParams.samplesPerBuffer;
+    snapshot.sampleRate = scanParams.dataParameters.sampleRate;
+    snapshot.savePath = scanParams.topLevelParameters.savePath;
+    snapshot.timestamp = getDateTimeString();
+    snapshot.decisionMaking = scanParams.topLevelParameters.decisionMaking;
+
+    stateSaver.submit(std::move(snapshot));
 }
 
 
@@ -311,6 +526,7 @@ void ScanRunner::refreshBaselineAndBadBins(int repeats, int subSpectra, int save
         saveVector(dataProcessor.runningAverage, scanParams.topLevelParameters.baselinePath + "fullPlots/runningAverage.csv");
     }
 
+    calibratedBaseline = dataProcessor.currentBaseline;
     dataProcessor.resetBaselining();
 }
 
@@ -324,7 +540,9 @@ void ScanRunner::acquireProcCalibration(int repeats, int subSpectra, int savePlo
         std::vector<std::vector<double>> rawData = dataProcessor.acquiredToRaw(rawStream, 
                                                                             alazarCard.acquisitionParams.buffersPerAcquisition, 
                                                                             alazarCard.acquisitionParams.samplesPerBuffer, 
-                                                                            fftwPlan);
+                                                                            fftwPlan,
+                                                                            fftwBatchPlan,
+                                                                            fftBatch);
         fftw_free(rawStream);
 
         for (std::vector<double> data : rawData){
@@ -385,6 +603,7 @@ void ScanRunner::acquireProcCalibration(int repeats, int subSpectra, int savePlo
     for (int bin : findOutliers(dataProcessor.runningAverage, 50, 4)){
         dataProcessor.badBins.push_back(bin);
     }
+    badBinsGauge().set((double)dataProcessor.badBins.size());
 
     dataProcessor.updateBaseline();
 }
@@ -398,6 +617,64 @@ void ScanRunner::step(double stepSize) {
 
 
 
+/**
+ * @brief Runs a multi-step scan on this runner. Each step acquires at the current center frequency, saves the state (and the data every 
+ * saveDataEvery steps) and then steps the exclusion state by stepSize in memory. The board setup, FFTW plans, SNR tables, baseline and 
+ * exclusion state are kept between steps. Leaves the runner at the next center frequency, ready for another call.
+ * 
+ * @details Steps overlap. As soon as a step stops acquiring, the next one starts acquiring in the other pipeline context while the tail of 
+ * the first drains through processing and decision making. The next step's decision thread only starts once the first is finished, saved 
+ * and stepped, so spectra are committed to bayesFactors in order. Saving only copies what the saver thread writes, so that gap stays short. The board is idle only for the time it takes to start the next pipeline.
+ * 
+ * @param steps - Number of acquisitions
+ * @param stepSize - Step between acquisitions in MHz
+ * @param saveDataEvery - Call saveData every this many steps (starting with the first), 0 to never save data
+ */
+void ScanRunner::runSteps(int steps, double stepSize, int saveDataEvery) {
+    if (steps <= 0) {
+        return;
+    }
+
+    int current = 0;
+    startPipeline(pipelines[current], scanParams.dataParameters.trueCenterFreq);
+    startDecisions(pipelines[current]);
+
+    for (int i = 0; i < steps; i++) {
+        PipelineContext& pipeline = pipelines[current];
+        PipelineContext& nextPipeline = pipelines[1 - current];
+        bool lastStep = (i == steps - 1);
+
+        // Hand the board to the next step as soon as this one stops acquiring
+        finishAcquisition(pipeline);
+        if (!lastStep) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            startPipeline(nextPipeline, scanParams.dataParameters.trueCenterFreq + stepSize);
+            addTime(TIMER_STEP, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        finishPipeline(pipeline);
+
+        // Only copies, queued for the saver thread. Both read bayesFactors, so they have to be taken before the next step's decisions start
+        saveState();
+        if (saveDataEvery > 0 && i % saveDataEvery == 0) {
+            saveData();
+        }
+
+        // Now the next step's spectra can be committed. Its decision queue has been filling since its acquisition started
+        double finishedCenterFreq = scanParams.dataParameters.trueCenterFreq;
+        step(stepSize);
+        if (!lastStep) {
+            startDecisions(nextPipeline);
+        }
+
+        std::cout << "Step " << i + 1 << " of " << steps << " at " << finishedCenterFreq << " MHz complete." << std::endl;
+
+        current = 1 - current;
+    }
+}
+
+
+
 void ScanRunner::setTarget(double targetCoupling) {
     decisionAgent.targetCoupling = targetCoupling;
 }
@@ -433,6 +710,8 @@ void ScanRunner::flushData() {
     bayesFactors.exclusionLine.freqAxis.clear();
     bayesFactors.coeffSumA.clear();
     bayesFactors.coeffSumB.clear();
+    bayesFactors.finalizedBins = Spectrum();
+    bayesFactors.baseIndex = 0;
 
     dataProcessor.resetBaselining();
     dataProcessor.currentBaseline = readVector("baseline.csv");
@@ -0,0 +1,206 @@
+/**
+ * @file bufferPool.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for BufferPool and PooledBuffer. See include\utils\bufferPool.hpp for class definitions.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+
+PooledBuffer::PooledBuffer() : sequence(0), count(0), pool(nullptr), data(nullptr) {}
+
+PooledBuffer::PooledBuffer(BufferPool* pool, pipeline_complex* data) : sequence(0), count(0), pool(pool), data(data) {}
+
+PooledBuffer::~PooledBuffer() {
+    release();
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) : sequence(other.sequence), count(other.count), tag(other.tag), pool(other.pool), data(other.data) {
+    other.pool = nullptr;
+    other.data = nullptr;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) {
+    if (this != &other) {
+        release();
+
+        sequence = other.sequence;
+        count = other.count;
+        tag = other.tag;
+        pool = other.pool;
+        data = other.data;
+        other.pool = nullptr;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+
+/**
+ * @brief Returns the block to its pool early. The handle is empty afterwards. Safe to call on an empty handle.
+ *
+ */
+void PooledBuffer::release() {
+    if (pool && data) {
+        pool->giveBack(data);
+    }
+    pool = nullptr;
+    data = nullptr;
+}
+
+
+
+/**
+ * @brief Construct a new Buffer Pool object. No memory is allocated until blocks are acquired.
+ *
+ * @param blockSize - number of pipeline_complex per block
+ * @param capacity - maximum number of blocks the pool will ever allocate
+ */
+BufferPool::BufferPool(size_t blockSize, size_t capacity) : blockSize(blockSize), capacity(capacity), allocated(0) {}
+
+
+/**
+ * @brief Destroy the Buffer Pool object, freeing every block it allocated.
+ *
+ */
+BufferPool::~BufferPool() {
+    freeBlocks();
+}
+
+
+/**
+ * @brief Changes the block size and capacity of the pool. Changing the block size frees every block, so it is only allowed while no handles
+ * are outstanding. Lowering the capacity frees idle blocks down to the new cap.
+ *
+ * @param blockSize - number of pipeline_complex per block
+ * @param capacity - maximum number of blocks the pool will ever allocate
+ */
+void BufferPool::configure(size_t blockSize, size_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (blockSize != this->blockSize) {
+            if (freeList.size() != allocated) {
+                throw std::runtime_error("Error: BufferPool resized while " + std::to_string(allocated - freeList.size()) + " blocks are in use\n");
+            }
+
+            for (pipeline_complex* block : allBlocks) {
+                fftw_free(block);
+            }
+            allBlocks.clear();
+            freeList.clear();
+            allocated = 0;
+        }
+
+        this->blockSize = blockSize;
+        this->capacity = capacity;
+
+        while (allocated > capacity && !freeList.empty()) {
+            pipeline_complex* block = freeList.back();
+            freeList.pop_back();
+
+            allBlocks.erase(std::find(allBlocks.begin(), allBlocks.end(), block));
+            fftw_free(block);
+            allocated--;
+        }
+    }
+    blockReturned.notify_all();
+}
+
+
+/**
+ * @brief Takes a block from the pool, allocating a new one if the pool is below capacity. Blocks until another thread gives a block back if
+ * every block is in use.
+ *
+ * @return PooledBuffer - handle to a block of getBlockSize() pipeline_complex. Contents are whatever the last user left in it.
+ */
+PooledBuffer BufferPool::acquire() {
+    std::unique_lock<std::mutex> lock(mtx);
+    blockReturned.wait(lock, [this]{return !freeList.empty() || allocated < capacity;});
+
+    if (freeList.empty()) {
+        pipeline_complex* block = reinterpret_cast<pipeline_complex*>(fftw_malloc(sizeof(pipeline_complex) * blockSize));
+        allBlocks.push_back(block);
+        allocated++;
+        return PooledBuffer(this, block);
+    }
+
+    pipeline_complex* block = freeList.back();
+    freeList.pop_back();
+    return PooledBuffer(this, block);
+}
+
+
+/**
+ * @brief Non-blocking version of acquire().
+ *
+ * @param buffer - set to the new handle on success, untouched otherwise
+ * @return true if a block was available
+ */
+bool BufferPool::tryAcquire(PooledBuffer& buffer) {
+    pipeline_complex* block = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (!freeList.empty()) {
+            block = freeList.back();
+            freeList.pop_back();
+        }
+        else if (allocated < capacity) {
+            block = reinterpret_cast<pipeline_complex*>(fftw_malloc(sizeof(pipeline_complex) * blockSize));
+            allBlocks.push_back(block);
+            allocated++;
+        }
+        else {
+            return false;
+        }
+    }
+
+    // Assign outside the lock, the handle being overwritten may give its own block back to this pool
+    buffer = PooledBuffer(this, block);
+    return true;
+}
+
+
+/**
+ * @brief Number of blocks that can be acquired without waiting.
+ *
+ */
+size_t BufferPool::available() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return freeList.size() + (capacity > allocated ? capacity - allocated : 0);
+}
+
+
+void BufferPool::giveBack(pipeline_complex* block) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // Capacity was lowered while this block was out
+        if (allocated > capacity) {
+            allBlocks.erase(std::find(allBlocks.begin(), allBlocks.end(), block));
+            fftw_free(block);
+            allocated--;
+            return;
+        }
+        freeList.push_back(block);
+    }
+    blockReturned.notify_one();
+}
+
+
+void BufferPool::freeBlocks() {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (pipeline_complex* block : allBlocks) {
+        fftw_free(block);
+    }
+    allBlocks.clear();
+    freeList.clear();
+    allocated = 0;
+}
@@ -151,4 +151,94 @@ std::vector<double> averageVectors(const std::vector<std::vector<double>>& vecs)
     }
 
     return vecAvg;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief Creates a plan that transforms batchSize contiguous spectra of samplesPerSpectrum points in one call. Spectrum k of a batch starts
+ * at input + k*samplesPerSpectrum and is written to output + k*samplesPerSpectrum.
+ *
+ * @param samplesPerSpectrum - Length of each transform
+ * @param batchSize - Number of transforms per call
+ * @param flags - FFTW planner flags
+ * @return fftw_plan - Out of place forward plan, to be freed with fftw_destroy_plan
+ */
+fftw_plan planFFTBatch(int samplesPerSpectrum, int batchSize, unsigned flags) {
+    fftw_complex* input = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * samplesPerSpectrum * batchSize));
+    fftw_complex* output = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * samplesPerSpectrum * batchSize));
+
+    fftw_plan batchPlan = fftw_plan_many_dft(1, &samplesPerSpectrum, batchSize,
+                                             input, NULL, 1, samplesPerSpectrum,
+                                             output, NULL, 1, samplesPerSpectrum,
+                                             FFTW_FORWARD, flags);
+
+    fftw_free(input);
+    fftw_free(output);
+
+    return batchPlan;
+}
+
+
+
+/**
+ * @brief Single precision version of planFFTBatch, for the float pipeline (SINGLE_PRECISION_PIPELINE).
+ *
+ */
+fftwf_plan planFFTBatchFloat(int samplesPerSpectrum, int batchSize, unsigned flags) {
+    fftwf_complex* input = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * samplesPerSpectrum * batchSize));
+    fftwf_complex* output = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * samplesPerSpectrum * batchSize));
+
+    fftwf_plan batchPlan = fftwf_plan_many_dft(1, &samplesPerSpectrum, batchSize,
+                                               input, NULL, 1, samplesPerSpectrum,
+                                               output, NULL, 1, samplesPerSpectrum,
+                                               FFTW_FORWARD, flags);
+
+    fftwf_free(input);
+    fftwf_free(output);
+
+    return batchPlan;
+}
+
+
+
+/**
+ * @brief Transforms count contiguous spectra. A full batch goes through batchPlan in one call, a short one (the end of an acquisition) is
+ * done one spectrum at a time with plan.
+ *
+ * @warning input and output must have the alignment the plans were made with. Pool blocks and fftw_malloc arrays do, and so does any offset
+ * of a whole number of spectra as long as samplesPerSpectrum is even (the Alazar record length always is).
+ *
+ * @param plan - Single spectrum plan
+ * @param batchPlan - batchSize spectrum plan from planFFTBatch
+ * @param batchSize - Number of spectra batchPlan transforms
+ * @param samplesPerSpectrum - Length of each transform
+ * @param input - count*samplesPerSpectrum input points. Not modified
+ * @param output - count*samplesPerSpectrum output points
+ * @param count - Number of spectra to transform, at most batchSize
+ */
+void executeFFTBatch(fftw_plan plan, fftw_plan batchPlan, int batchSize, int samplesPerSpectrum, fftw_complex* input, fftw_complex* output, int count) {
+    if (count == batchSize) {
+        fftw_execute_dft(batchPlan, input, output);
+        return;
+    }
+
+    for (int k = 0; k < count; k++) {
+        fftw_execute_dft(plan, input + k*samplesPerSpectrum, output + k*samplesPerSpectrum);
+    }
+}
+
+
+/**
+ * @brief Single precision version of executeFFTBatch, for the float pipeline (SINGLE_PRECISION_PIPELINE).
+ *
+ */
+void executeFFTBatch(fftwf_plan plan, fftwf_plan batchPlan, int batchSize, int samplesPerSpectrum, fftwf_complex* input, fftwf_complex* output, int count) {
+    if (count == batchSize) {
+        fftwf_execute_dft(batchPlan, input, output);
+        return;
+    }
+
+    for (int k = 0; k < count; k++) {
+        fftwf_execute_dft(plan, input + k*samplesPerSpectrum, output + k*samplesPerSpectrum);
+    }
+}
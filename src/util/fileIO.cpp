@@ -227,12 +227,11 @@ std::string getDateTimeString() {
     // Save info for exclusion comparisons
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
-    std::tm localTime;
-    localtime_s(&localTime, &time);
+    std::tm local = localTime(time);
 
     // Format the date and time as a string
     char datetimeStr[100];
-    std::strftime(datetimeStr, sizeof(datetimeStr), "%Y-%m-%d_%H-%M-%S", &localTime);
+    std::strftime(datetimeStr, sizeof(datetimeStr), "%Y-%m-%d_%H-%M-%S", &local);
 
     return std::string(datetimeStr);
 }
@@ -275,34 +274,22 @@ void saveSpectraFromQueue(std::queue<Spectrum>& spectraQueue, std::string filena
 
 
 bool deleteAllFilesInFolder(const std::string& folderPath) {
-    WIN32_FIND_DATA findFileData;
-    HANDLE hFind = INVALID_HANDLE_VALUE;
-
-    // Add a wildcard to search for all files in the directory
-    std::string folderSearchPath = folderPath + "\\*";
-    hFind = FindFirstFile(folderSearchPath.c_str(), &findFileData);
-
-    if (hFind == INVALID_HANDLE_VALUE) {
-        std::cerr << "FindFirstFile failed. Error: " << GetLastError() << std::endl;
+    std::vector<std::string> files;
+    if (!listFiles(folderPath, files)) {
         return false;
     }
 
-    do {
-        // Skip directories, "." and ".."
-        if (!(findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-            std::string filePath = folderPath + "\\" + findFileData.cFileName;
-            if (!DeleteFile(filePath.c_str())) {
-                std::cerr << "Failed to delete file: " << filePath << ". Error: " << GetLastError() << std::endl;
-                // Optionally, continue trying to delete other files even if one fails
-            }
+    // Only files, subfolders are left alone. Keep going past a failure so as much as possible is deleted
+    bool success = true;
+    for (std::string const& fileName : files) {
+        std::string filePath = folderPath + "/" + fileName;
+        if (std::remove(filePath.c_str()) != 0) {
+            std::cerr << "Failed to delete file: " << filePath << std::endl;
+            success = false;
         }
-        // If you also want to delete directories, you would add an else branch here
-        // to handle directory deletion (recursively calling this function).
-
-    } while (FindNextFile(hFind, &findFileData) != 0);
+    }
 
-    FindClose(hFind);
-    return true;
+    return success;
 }
 
 
@@ -0,0 +1,104 @@
+/**
+ * @file mappedFile.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for MappedFile. See include\utils\mappedFile.hpp for the class definition.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() : mapping(nullptr), mappedBytes(0) {
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+
+
+/**
+ * @brief Maps all of filename read only, hinting sequential access. Closes any file already mapped. Throws if the file can't be opened, is
+ * empty or can't be mapped.
+ *
+ * @param filename - File to map
+ */
+void MappedFile::open(std::string const& filename) {
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Error: Unable to open " + filename);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    mappedBytes = (size_t)fileSize.QuadPart;
+
+    mappingHandle = (mappedBytes > 0) ? CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    mapping = (mappingHandle != NULL) ? reinterpret_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Unable to open " + filename);
+    }
+
+    struct stat fileStat;
+    fstat(fd, &fileStat);
+    mappedBytes = (size_t)fileStat.st_size;
+
+    void* view = (mappedBytes > 0) ? mmap(nullptr, mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+
+    if (view != MAP_FAILED) {
+        madvise(view, mappedBytes, MADV_SEQUENTIAL);
+        mapping = reinterpret_cast<const char*>(view);
+    }
+#endif
+
+    if (mapping == nullptr) {
+        close();
+        throw std::runtime_error("Error: Unable to map " + filename);
+    }
+}
+
+
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mapping != nullptr) {
+        UnmapViewOfFile(mapping);
+    }
+    if (mappingHandle != NULL) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+    }
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mapping != nullptr) {
+        munmap(const_cast<char*>(mapping), mappedBytes);
+    }
+#endif
+
+    mapping = nullptr;
+    mappedBytes = 0;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file metricsRegistry.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for the metrics registry and MetricsExporter. See include\utils\metricsRegistry.hpp for class
+ *        definitions.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+
+// Prometheus text for a sample value, which spells the infinities and NaN out
+static std::string formatValue(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return (value > 0) ? "+Inf" : "-Inf";
+    }
+
+    std::ostringstream stream;
+    stream << std::setprecision(12) << value;
+    return stream.str();
+}
+
+// Metric names follow the Prometheus rules, [a-zA-Z_:][a-zA-Z0-9_:]*, so the text export never needs escaping
+static bool validName(std::string const& name) {
+    if (name.empty() || std::isdigit((unsigned char)name[0])) {
+        return false;
+    }
+    for (char c : name) {
+        if (!std::isalnum((unsigned char)c) && c != '_' && c != ':') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void writeHeader(std::ostream& out, Metric const& metric) {
+    if (!metric.getHelp().empty()) {
+        out << "# HELP " << metric.getName() << " " << metric.getHelp() << "\n";
+    }
+    out << "# TYPE " << metric.getName() << " " << metric.typeName() << "\n";
+}
+
+
+
+/**
+ * @brief The registry the pipeline reports into. Created on first use and kept for the life of the process, so references to its metrics
+ * never dangle.
+ *
+ */
+MetricsRegistry& metricsRegistry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+/**
+ * @brief Histogram bounds start, start*factor, ..., count of them.
+ *
+ */
+std::vector<double> exponentialBuckets(double start, double factor, int count) {
+    std::vector<double> bounds(count > 0 ? count : 0);
+    for (int n = 0; n < count; n++) {
+        bounds[n] = start;
+        start *= factor;
+    }
+    return bounds;
+}
+
+/**
+ * @brief Acquisition metrics of the registry, registered on first use.
+ *
+ */
+AcquisitionMetrics& acquisitionMetrics() {
+    static AcquisitionMetrics metrics = {
+        metricsRegistry().counter("acquisition_buffers_total", "DMA buffers handed to the pipeline"),
+        metricsRegistry().counter("acquisition_samples_total", "Samples per channel handed to the pipeline"),
+        metricsRegistry().counter("acquisition_failures_total", "Acquisitions ended by a board error or a pipeline overflow"),
+        metricsRegistry().gauge("acquisition_duty_cycle", "Sampled time over wall time of the last acquisition"),
+        metricsRegistry().gauge("acquisition_sample_rate_hz", "Sample rate of the last acquisition")
+    };
+    return metrics;
+}
+
+/**
+ * @brief Gauge of the bins DataProcessor masks as bad.
+ *
+ */
+MetricGauge& badBinsGauge() {
+    static MetricGauge& gauge = metricsRegistry().gauge("bad_bins", "Bins masked as bad in the raw spectrum");
+    return gauge;
+}
+
+
+
+/**
+ * @brief Sets the duty cycle and sample rate gauges at the end of an acquisition.
+ *
+ * @param samplesPerBuffer - Per channel
+ * @param rate - Sample rate (Hz)
+ * @param buffersCompleted - Buffers handed to the pipeline
+ * @param acquisitionTime - Wall time of the acquisition (s)
+ */
+void AcquisitionMetrics::recordAcquisition(double samplesPerBuffer, double rate, unsigned long long buffersCompleted, double acquisitionTime) {
+    dutyCycle.set((acquisitionTime > 0) ? samplesPerBuffer/rate*buffersCompleted/acquisitionTime : 0);
+    sampleRate.set(rate);
+}
+
+
+
+void MetricCounter::writePrometheus(std::ostream& out) const {
+    writeHeader(out, *this);
+    out << name << " " << get() << "\n";
+}
+
+void MetricGauge::add(double delta) {
+    double current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+}
+
+void MetricGauge::writePrometheus(std::ostream& out) const {
+    writeHeader(out, *this);
+    out << name << " " << formatValue(get()) << "\n";
+}
+
+
+
+/**
+ * @brief Construct a new histogram. With no bounds, uses METRICS_DEFAULT_BUCKETS exponential buckets from 10 us, which suit stage times in
+ * seconds.
+ *
+ * @param bounds - Upper bounds of the buckets, sorted here
+ */
+MetricHistogram::MetricHistogram(std::string const& name, std::string const& help, std::vector<double> const& bounds)
+    : Metric(name, help), bounds(bounds), count(0), sum(0.0)
+{
+    if (this->bounds.empty()) {
+        this->bounds = exponentialBuckets(1e-5, 4, METRICS_DEFAULT_BUCKETS);
+    }
+    std::sort(this->bounds.begin(), this->bounds.end());
+
+    buckets.reset(new std::atomic<std::uint64_t>[this->bounds.size() + 1]);
+    for (size_t n = 0; n <= this->bounds.size(); n++) {
+        buckets[n].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(double value) {
+    size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    double current = sum.load(std::memory_order_relaxed);
+    while (!sum.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+}
+
+// Buckets are cumulative in the export. The count is taken from the buckets so the +Inf bucket and _count always agree
+void MetricHistogram::writePrometheus(std::ostream& out) const {
+    writeHeader(out, *this);
+
+    std::uint64_t cumulative = 0;
+    for (size_t n = 0; n < bounds.size(); n++) {
+        cumulative += buckets[n].load(std::memory_order_relaxed);
+        out << name << "_bucket{le=\"" << formatValue(bounds[n]) << "\"} " << cumulative << "\n";
+    }
+    cumulative += buckets[bounds.size()].load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum " << formatValue(getSum()) << "\n";
+    out << name << "_count " << cumulative << "\n";
+}
+
+json MetricHistogram::toJson() const {
+    std::vector<std::uint64_t> counts(bounds.size() + 1);
+    for (size_t n = 0; n < counts.size(); n++) {
+        counts[n] = buckets[n].load(std::memory_order_relaxed);
+    }
+
+    json histogram;
+    histogram["bounds"] = bounds;
+    histogram["counts"] = counts;
+    histogram["sum"] = getSum();
+    histogram["count"] = std::accumulate(counts.begin(), counts.end(), (std::uint64_t)0);
+    return histogram;
+}
+
+
+
+// The metric called name, nullptr if there is none yet. Throws if it was registered as another type. Called with the lock held
+template <typename T>
+T* MetricsRegistry::find(std::string const& name) {
+    auto existing = metricsByName.find(name);
+    if (existing == metricsByName.end()) {
+        return nullptr;
+    }
+
+    T* metric = dynamic_cast<T*>(existing->second);
+    if (metric == nullptr) {
+        throw std::runtime_error("Error: Metric " + name + " is already registered as a " + existing->second->typeName());
+    }
+    return metric;
+}
+
+/**
+ * @brief Counter called name, registered on the first call.
+ *
+ * @param name - Prometheus style name, e.g. acquisition_buffers_total
+ * @param help - One line description for the export, only used when the counter is registered
+ * @return MetricCounter& - Valid for the life of the registry
+ */
+MetricCounter& MetricsRegistry::counter(std::string const& name, std::string const& help) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    MetricCounter* existing = find<MetricCounter>(name);
+    if (existing != nullptr) {
+        return *existing;
+    }
+    if (!validName(name)) {
+        throw std::runtime_error("Error: Invalid metric name " + name);
+    }
+
+    MetricCounter* metric = new MetricCounter(name, help);
+    metrics.emplace_back(metric);
+    metricsByName[name] = metric;
+    return *metric;
+}
+
+/**
+ * @brief Gauge called name, registered on the first call.
+ *
+ * @param name - Prometheus style name, e.g. save_queue_depth
+ * @param help - One line description for the export, only used when the gauge is registered
+ * @return MetricGauge& - Valid for the life of the registry
+ */
+MetricGauge& MetricsRegistry::gauge(std::string const& name, std::string const& help) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    MetricGauge* existing = find<MetricGauge>(name);
+    if (existing != nullptr) {
+        return *existing;
+    }
+    if (!validName(name)) {
+        throw std::runtime_error("Error: Invalid metric name " + name);
+    }
+
+    MetricGauge* metric = new MetricGauge(name, help);
+    metrics.emplace_back(metric);
+    metricsByName[name] = metric;
+    return *metric;
+}
+
+/**
+ * @brief Histogram called name, registered on the first call.
+ *
+ * @param name - Prometheus style name, e.g. fft_batch_seconds
+ * @param help - One line description for the export, only used when the histogram is registered
+ * @param bounds - Upper bounds of the buckets, only used when the histogram is registered. Empty for the default time buckets
+ * @return MetricHistogram& - Valid for the life of the registry
+ */
+MetricHistogram& MetricsRegistry::histogram(std::string const& name, std::string const& help, std::vector<double> const& bounds) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    MetricHistogram* existing = find<MetricHistogram>(name);
+    if (existing != nullptr) {
+        return *existing;
+    }
+    if (!validName(name)) {
+        throw std::runtime_error("Error: Invalid metric name " + name);
+    }
+
+    MetricHistogram* metric = new MetricHistogram(name, help, bounds);
+    metrics.emplace_back(metric);
+    metricsByName[name] = metric;
+    return *metric;
+}
+
+void MetricsRegistry::writePrometheus(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    for (std::unique_ptr<Metric> const& metric : metrics) {
+        metric->writePrometheus(out);
+    }
+}
+
+json MetricsRegistry::toJson() const {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    json values = json::object();
+    for (std::unique_ptr<Metric> const& metric : metrics) {
+        values[metric->getName()] = metric->toJson();
+    }
+    return values;
+}
+
+
+
+MetricsExporter::MetricsExporter() : registry(nullptr), format(METRICS_PROMETHEUS), interval(METRICS_EXPORT_INTERVAL), stopRequested(false) {}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+
+
+/**
+ * @brief Starts the export thread. The first export happens straight away. Stops any exporter already running.
+ *
+ * @param registry - Registry to export, must outlive the exporter
+ * @param filename - File to write. METRICS_PROMETHEUS also uses filename + ".tmp"
+ * @param format - METRICS_PROMETHEUS or METRICS_JSON_LINES
+ * @param interval - Seconds between exports
+ */
+void MetricsExporter::start(MetricsRegistry& registry, std::string const& filename, int format, double interval) {
+    stop();
+
+    this->registry = &registry;
+    this->filename = filename;
+    this->format = format;
+    this->interval = (interval > 0) ? interval : METRICS_EXPORT_INTERVAL;
+    stopRequested = false;
+
+    exportThread = std::thread(&MetricsExporter::exportPeriodically, this);
+}
+
+
+
+/**
+ * @brief Stops the export thread and writes the final values. Safe to call when not running.
+ *
+ */
+void MetricsExporter::stop() {
+    if (!isRunning()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopRequested = true;
+    }
+    wake.notify_all();
+    exportThread.join();
+
+    exportNow();
+}
+
+
+
+/**
+ * @brief Writes the registry once. Errors are printed and otherwise ignored, the next export tries again.
+ *
+ */
+void MetricsExporter::exportNow() {
+    if (registry == nullptr || filename.empty()) {
+        return;
+    }
+
+    if (format == METRICS_JSON_LINES) {
+        json line;
+        line["time"] = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        line["metrics"] = registry->toJson();
+
+        std::ofstream file(filename, std::ios::app);
+        file << line.dump() << "\n";
+        if (!file) {
+            std::cout << "Error: Unable to append metrics to " << filename << std::endl;
+        }
+        return;
+    }
+
+    std::string tempFilename = filename + ".tmp";
+    {
+        std::ofstream file(tempFilename, std::ios::trunc);
+        registry->writePrometheus(file);
+        if (!file) {
+            std::cout << "Error: Unable to write metrics to " << tempFilename << std::endl;
+            return;
+        }
+    }
+    if (!replaceFile(tempFilename, filename)) {
+        std::cout << "Error: Unable to replace " << filename << " with the latest metrics" << std::endl;
+    }
+}
+
+
+
+void MetricsExporter::exportPeriodically() {
+    std::chrono::duration<double> period(interval);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopRequested) {
+        lock.unlock();
+        exportNow();
+        lock.lock();
+
+        wake.wait_for(lock, period, [this] { return stopRequested; });
+    }
+}
@@ -20,5 +20,132 @@ ScanParameters unpackScanParameters(json const& inputParams) {
     scanParameters.filterParameters.poleNumber = inputParams["filterParams"]["poleNumber"];
     scanParameters.filterParameters.stopbandAttenuation = inputParams["filterParams"]["stopbandAttenuation"];
 
+    // Optional, defaults are in PipelineParameters. Each field is either one value for every queue or an array in QUEUE_* order
+    if (inputParams.contains("pipelineParams")) {
+        json const& pipelineParams = inputParams["pipelineParams"];
+
+        if (pipelineParams.contains("fftThreads")) {
+            scanParameters.pipelineParameters.fftThreads = pipelineParams["fftThreads"];
+        }
+
+        if (pipelineParams.contains("fftBatch")) {
+            scanParameters.pipelineParameters.fftBatch = pipelineParams["fftBatch"];
+        }
+
+        if (pipelineParams.contains("fusedAccumulation")) {
+            scanParameters.pipelineParameters.fusedAccumulation = pipelineParams["fusedAccumulation"];
+        }
+
+        if (pipelineParams.contains("recordPath")) {
+            scanParameters.pipelineParameters.recordPath = pipelineParams["recordPath"];
+        }
+
+        if (pipelineParams.contains("replayPath")) {
+            scanParameters.pipelineParameters.replayPath = pipelineParams["replayPath"];
+        }
+
+        if (pipelineParams.contains("replaySpeed")) {
+            scanParameters.pipelineParameters.replaySpeed = pipelineParams["replaySpeed"];
+        }
+
+        if (pipelineParams.contains("traceCapacity")) {
+            scanParameters.pipelineParameters.traceCapacity = pipelineParams["traceCapacity"];
+        }
+
+        if (pipelineParams.contains("tracePath")) {
+            scanParameters.pipelineParameters.tracePath = pipelineParams["tracePath"];
+        }
+
+        if (pipelineParams.contains("metricsPath")) {
+            scanParameters.pipelineParameters.metricsPath = pipelineParams["metricsPath"];
+        }
+
+        if (pipelineParams.contains("metricsFormat")) {
+            std::string format = pipelineParams["metricsFormat"];
+            scanParameters.pipelineParameters.metricsFormat = (format == "json") ? METRICS_JSON_LINES : METRICS_PROMETHEUS;
+        }
+
+        if (pipelineParams.contains("metricsInterval")) {
+            scanParameters.pipelineParameters.metricsInterval = pipelineParams["metricsInterval"];
+        }
+
+        for (int n = 0; n < NUM_QUEUES; n++) {
+            if (pipelineParams.contains("queueCapacity")) {
+                json const& capacity = pipelineParams["queueCapacity"];
+                scanParameters.pipelineParameters.queueCapacity[n] = capacity.is_array() ? capacity.at(n) : capacity;
+            }
+
+            if (pipelineParams.contains("queuePolicy")) {
+                json const& policy = pipelineParams["queuePolicy"];
+                scanParameters.pipelineParameters.queuePolicy[n] = parseQueuePolicy(policy.is_array() ? policy.at(n) : policy);
+            }
+        }
+
+        for (int n = 0; n < NUM_WORKER_ROLES; n++) {
+            if (pipelineParams.contains("workerAffinity")) {
+                json const& affinity = pipelineParams["workerAffinity"];
+                scanParameters.pipelineParameters.workerAffinity[n] = affinity.is_array() ? affinity.at(n) : affinity;
+            }
+
+            if (pipelineParams.contains("workerPriority")) {
+                json const& priority = pipelineParams["workerPriority"];
+                scanParameters.pipelineParameters.workerPriority[n] = parseWorkerPriority(priority.is_array() ? priority.at(n) : priority);
+            }
+        }
+    }
+
     return scanParameters;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief Converts a queue policy from the parameter json ("block", "dropOldest" or "flagOverflow") to its QUEUE_* code.
+ *
+ */
+int parseQueuePolicy(std::string const& policy) {
+    if (policy == "block") {
+        return QUEUE_BLOCK;
+    }
+    else if (policy == "dropOldest") {
+        return QUEUE_DROP_OLDEST;
+    }
+    else if (policy == "flagOverflow") {
+        return QUEUE_FLAG_OVERFLOW;
+    }
+
+    throw std::invalid_argument("Unknown queue policy: " + policy);
+}
+
+
+/**
+ * @brief Converts a worker priority from the parameter json to its WORKER_PRIORITY_* value. Takes a name ("lowest", "belowNormal", "normal",
+ * "aboveNormal", "highest" or "timeCritical") or the raw Windows thread priority.
+ *
+ */
+int parseWorkerPriority(json const& priority) {
+    if (priority.is_number()) {
+        return priority;
+    }
+
+    std::string name = priority;
+    if (name == "lowest") {
+        return WORKER_PRIORITY_LOWEST;
+    }
+    else if (name == "belowNormal") {
+        return WORKER_PRIORITY_BELOW_NORMAL;
+    }
+    else if (name == "normal") {
+        return WORKER_PRIORITY_NORMAL;
+    }
+    else if (name == "aboveNormal") {
+        return WORKER_PRIORITY_ABOVE_NORMAL;
+    }
+    else if (name == "highest") {
+        return WORKER_PRIORITY_HIGHEST;
+    }
+    else if (name == "timeCritical") {
+        return WORKER_PRIORITY_TIME_CRITICAL;
+    }
+
+    throw std::invalid_argument("Unknown worker priority: " + name);
+}
@@ -1,78 +1,315 @@
 #include "decs.hpp"
 
-void fftThread(fftw_plan plan, int samplesPerSpectrum, ThreadSafeQueue<fftw_complex*>& inputQueue, ThreadSafeQueue<fftw_complex*>& outputQueue){
+/**
+ * @brief One FFT worker. Several run in parallel on the same plans (fftw_execute_dft is thread safe), each on its own lane of the raw and FFT
+ * queues. Each block holds a batch of up to batchSize buffers, transformed with one call to batchPlan. The output block comes from the shared
+ * FFT pool and keeps the sequence number and count of its input.
+ *
+ */
+void fftThread(pipeline_plan plan, pipeline_plan batchPlan, int batchSize, int samplesPerSpectrum, PipelineQueue<PooledBuffer>& inputQueue, PipelineQueue<PooledBuffer>& outputQueue, BufferPool& outputPool){
+    static MetricHistogram& batchTime = metricsRegistry().histogram("fft_batch_seconds", "Time to transform one block of buffers");
+    static MetricCounter& transformedSpectra = metricsRegistry().counter("fft_spectra_total", "Spectra transformed by the FFT workers");
+
     while (true) {
-        std::shared_ptr<fftw_complex*> rawDataPointer = inputQueue.waitAndPop();
+        PooledBuffer rawData;
+        inputQueue.waitAndPop(rawData);
 
-        startTimer(TIMER_FFT);
-        fftw_complex* rawData = *rawDataPointer;
-        fftw_complex* fftData = processDataFFT(rawData, plan, samplesPerSpectrum);
-    
-        fftw_free(rawData);
-        stopTimer(TIMER_FFT);
+        // Empty buffers end lanes that don't carry the final buffer, or every lane on an unexpected exit. Pass it down the pipeline
+        if (rawData.empty()) {
+            outputQueue.pushFinal(PooledBuffer());
+            break;
+        }
+
+        traceEvent(rawData.tag, TRACE_FFT, TRACE_DEQUEUE);
+
+        // Acquire before starting the timer so waiting on the magnitude thread isn't counted as FFT time
+        PooledBuffer fftData = outputPool.acquire();
+        fftData.sequence = rawData.sequence;
+        fftData.count = rawData.count;
+        fftData.tag = rawData.tag;
+
+        // The workers overlap, so each times itself and adds to TIMER_FFT (total worker time, not wall time)
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        executeFFTBatch(plan, batchPlan, batchSize, samplesPerSpectrum, rawData.get(), fftData.get(), (int)rawData.count);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Hand the input block back to the acquisition pool
+        rawData.release();
+        addTime(TIMER_FFT, elapsed, fftData.count);
+        batchTime.observe(elapsed);
+        transformedSpectra.add(fftData.count);
+        traceEvent(fftData.tag, TRACE_FFT, TRACE_FINISH);
+        traceEvent(fftData.tag, TRACE_MAGNITUDE, TRACE_ENQUEUE);
 
         // The inputComplete flag should be thrown while pushing the last data to the output queue, before the condition variable is notified
         if (inputQueue.isInputComplete() && inputQueue.empty()) {
-            outputQueue.pushFinal(fftData);
+            outputQueue.pushFinal(std::move(fftData));
             break;
         }
         else {
-            outputQueue.push(fftData);
+            outputQueue.push(std::move(fftData));
         }
     }   
 }
 
 
-void magnitudeThread(int samplesPerSpectrum, DataProcessor& dataProcessor, ThreadSafeQueue<fftw_complex*>& inputQueue, ThreadSafeQueue<std::vector<double>>& outputQueue){
+/**
+ * @brief Reads FFT blocks from the worker lanes in sequence order. Shared by the magnitude thread and the fused accumulation thread.
+ *
+ * @details Block k is in lane k % numLanes, so popping the lanes round robin restores acquisition order. A block whose sequence is ahead of
+ * the expected one means the expected block was dropped (QUEUE_DROP_OLDEST). It is held back until its turn so order is still kept. A lane
+ * that delivers an empty block is finished. If every lane finishes without the final block the acquisition ended unexpectedly.
+ *
+ */
+class InOrderReader {
+public:
+    InOrderReader(LanedQueue<PooledBuffer>& inputQueue) 
+        : inputQueue(inputQueue), held(inputQueue.numLanes()), laneDone(inputQueue.numLanes(), false), lanesDone(0), nextSequence(0) {}
+
+    // Waits for the next block. Returns false once every lane has ended without a final block
+    bool next(PooledBuffer& block, bool& finalBlock) {
+        int numLanes = inputQueue.numLanes();
+
+        while (true) {
+            int laneIndex = (int)(nextSequence % numLanes);
+            PipelineQueue<PooledBuffer>& lane = inputQueue.lane(nextSequence);
+
+            if (laneDone[laneIndex]) {
+                nextSequence++;
+                continue;
+            }
+
+            if (!held[laneIndex].empty()) {
+                block = std::move(held[laneIndex]);
+            }
+            else {
+                lane.waitAndPop(block);
+            }
+
+            if (block.empty()) {
+                laneDone[laneIndex] = true;
+                lanesDone++;
+
+                if (lanesDone == numLanes) {
+                    return false;
+                }
+                nextSequence++;
+                continue;
+            }
+
+            if (block.sequence > nextSequence) {
+                held[laneIndex] = std::move(block);
+                nextSequence++;
+                continue;
+            }
+            nextSequence = block.sequence + 1;
+
+            finalBlock = lane.isInputComplete() && lane.empty();
+            return true;
+        }
+    }
+
+private:
+    LanedQueue<PooledBuffer>& inputQueue;
+    std::vector<PooledBuffer> held;
+    std::vector<bool> laneDone;
+    int lanesDone;
+    size_t nextSequence;
+};
+
+
+/**
+ * @brief Takes the FFT results from the worker lanes in sequence order and converts them to power, one spectrum per buffer in each block.
+ *
+ */
+void magnitudeThread(int samplesPerSpectrum, DataProcessor& dataProcessor, LanedQueue<PooledBuffer>& inputQueue, PipelineQueue<Spectrum>& outputQueue){
+    InOrderReader reader(inputQueue);
+
     while (true) {
-        std::shared_ptr<fftw_complex*> fftDataPointer = inputQueue.waitAndPop();
+        PooledBuffer fftBuffer;
+        bool finalBlock = false;
 
-        startTimer(TIMER_MAG);
-        fftw_complex* fftData = *fftDataPointer;
+        if (!reader.next(fftBuffer, finalBlock)) {
+            outputQueue.pushFinal(Spectrum());
+            break;
+        }
+        traceEvent(fftBuffer.tag, TRACE_MAGNITUDE, TRACE_DEQUEUE);
 
-        // Main processing logic
-        std::vector<double> magData(samplesPerSpectrum);
-        for (int i = 0; i < samplesPerSpectrum; i++) {
-            magData[i] = ( fftData[i][0]*fftData[i][0] + fftData[i][1]*fftData[i][1] ) / samplesPerSpectrum / 50; // Hard code in 50 Ohm input impedance
+        // Each block is a batch of spectra. The last spectrum of the final block is the final element
+        int count = (int)fftBuffer.count;
+
+        for (int k = 0; k < count; k++) {
+            // Two steps can be in this stage at once (ScanRunner::runSteps), so stages after the FFT also time with addTime
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            pipeline_complex* fftData = fftBuffer.get() + (size_t)k*samplesPerSpectrum;
+
+            // Main processing logic. |X|^2 in pipeline precision, scaled in double
+            std::vector<double> magData(samplesPerSpectrum);
+            for (int i = 0; i < samplesPerSpectrum; i++) {
+                pipeline_real power = fftData[i][0]*fftData[i][0] + fftData[i][1]*fftData[i][1];
+                magData[i] = (double)power / samplesPerSpectrum / 50; // Hard code in 50 Ohm input impedance
+            }
+
+            Spectrum subSpectrum;
+            subSpectrum.powers = dataProcessor.trimDC(dataProcessor.removeBadBins(magData));
+            subSpectrum.tag = bufferTag(fftBuffer.tag, k);
+
+            addTime(TIMER_MAG, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            traceEvent(subSpectrum.tag, TRACE_MAGNITUDE, TRACE_FINISH);
+            traceEvent(subSpectrum.tag, TRACE_AVERAGE, TRACE_ENQUEUE);
+
+            if (finalBlock && k == count - 1) {
+                outputQueue.pushFinal(std::move(subSpectrum));
+            }
+            else {
+                outputQueue.push(std::move(subSpectrum));
+            }
+        }
+        fftBuffer.release();
+
+        if (finalBlock) {
+            break;
         }
-        magData = dataProcessor.trimDC(dataProcessor.removeBadBins(magData));
-        fftw_free(fftData);
+    }
+}
 
-        stopTimer(TIMER_MAG);
 
-        if (inputQueue.isInputComplete() && inputQueue.empty()) {
-            outputQueue.pushFinal(magData);
+/**
+ * @brief Fused replacement for the magnitude and averaging threads. Takes the FFT results in sequence order and adds |X|^2 of every spectrum
+ * straight into one preallocated accumulator. Scaling, bad bin and DC masking and the running average update are done once per averaged 
+ * spectrum instead of once per sub-spectrum, so each sub-spectrum costs a single pass over memory.
+ *
+ * @details The output is the same as magnitudeThread followed by averagingThread: masking is linear so it can be applied after averaging, and 
+ * a short average is pushed with the final element. 
+ *
+ */
+void accumulationThread(int samplesPerSpectrum, DataProcessor& dataProcessor, double trueCenterFreq, 
+                        LanedQueue<PooledBuffer>& inputQueue, PipelineQueue<Spectrum>& outputQueue, int subSpectraAveragingNumber)
+{
+    InOrderReader reader(inputQueue);
+
+    std::vector<double> accumulator(samplesPerSpectrum, 0.0);
+    int subSpectraAccumulated = 0;
+    int subSpectraAveraged = 0;
+    TraceTag accumulatedTag;
+
+    // Scales the accumulator into an averaged raw spectrum and masks it. Returns an empty spectrum if nothing was accumulated
+    auto finalizeSpectrum = [&]() {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        Spectrum rawSpectrum;
+        if (subSpectraAccumulated > 0) {
+            double scale = 1.0 / subSpectraAccumulated / samplesPerSpectrum / 50; // Hard code in 50 Ohm input impedance
+
+            rawSpectrum.powers.resize(samplesPerSpectrum);
+            for (int i = 0; i < samplesPerSpectrum; i++) {
+                rawSpectrum.powers[i] = accumulator[i] * scale;
+                accumulator[i] = 0;
+            }
+            dataProcessor.maskBadBinsAndDC(rawSpectrum.powers);
+            dataProcessor.addAveragedSpectrumToRunningAverage(rawSpectrum.powers, subSpectraAccumulated);
+
+            rawSpectrum.freqAxis = dataProcessor.SNR.freqAxis;
+            rawSpectrum.tag = accumulatedTag;
+        }
+        rawSpectrum.trueCenterFreq = trueCenterFreq;
+
+        int spectrumSize = subSpectraAccumulated;
+        subSpectraAveraged += subSpectraAccumulated;
+        subSpectraAccumulated = 0;
+
+        // Counted in sub-spectra, like the averaging thread
+        addTime(TIMER_AVERAGE, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), spectrumSize);
+
+        // Always pushed straight away
+        if (!rawSpectrum.powers.empty()) {
+            traceEvent(rawSpectrum.tag, TRACE_AVERAGE, TRACE_FINISH);
+            traceEvent(rawSpectrum.tag, TRACE_PROCESS, TRACE_ENQUEUE);
+        }
+        return rawSpectrum;
+    };
+
+    while (true) {
+        PooledBuffer fftBuffer;
+        bool finalBlock = false;
+
+        // Every lane ended without a final block, push what was accumulated as the final element
+        if (!reader.next(fftBuffer, finalBlock)) {
+            outputQueue.pushFinal(finalizeSpectrum());
             break;
         }
-        else {
-            outputQueue.push(magData);
+        traceEvent(fftBuffer.tag, TRACE_MAGNITUDE, TRACE_DEQUEUE);
+
+        int count = (int)fftBuffer.count;
+        for (int k = 0; k < count; k++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            pipeline_complex* fftData = fftBuffer.get() + (size_t)k*samplesPerSpectrum;
+
+            // |X|^2 in pipeline precision, summed in double so long averages don't lose the float mantissa
+            for (int i = 0; i < samplesPerSpectrum; i++) {
+                pipeline_real power = fftData[i][0]*fftData[i][0] + fftData[i][1]*fftData[i][1];
+                accumulator[i] += (double)power;
+            }
+
+            TraceTag subSpectrumTag = bufferTag(fftBuffer.tag, k);
+            accumulatedTag = (subSpectraAccumulated == 0) ? subSpectrumTag : mergeTags(accumulatedTag, subSpectrumTag);
+            subSpectraAccumulated++;
+
+            addTime(TIMER_MAG, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            traceEvent(subSpectrumTag, TRACE_MAGNITUDE, TRACE_FINISH);
+
+            // The last spectrum of the final block is pushed below with pushFinal
+            if (subSpectraAccumulated == subSpectraAveragingNumber && !(finalBlock && k == count - 1)) {
+                outputQueue.push(finalizeSpectrum());
+            }
+        }
+        fftBuffer.release();
+
+        if (finalBlock) {
+            outputQueue.pushFinal(finalizeSpectrum());
+            break;
         }
     }
+
+    setMetric(ACQUIRED_SPECTRA, subSpectraAveraged);
+    setMetric(SPECTRUM_AVERAGE_SIZE, subSpectraAveragingNumber);
 }
 
 
 void averagingThread(DataProcessor& dataProcessor, double trueCenterFreq, 
-                    ThreadSafeQueue<std::vector<double>>& inputQueue, ThreadSafeQueue<Spectrum>& outputQueue, 
+                    PipelineQueue<Spectrum>& inputQueue, PipelineQueue<Spectrum>& outputQueue, 
                     int subSpectraAveragingNumber = 20) 
 {
     std::vector<std::vector<double>> subSpectra;
     int subSpectraAveraged = 0;
+    TraceTag averagedTag;
 
     while (true) {
-        std::shared_ptr<std::vector<double>> magDataPointer = inputQueue.waitAndPop();
+        Spectrum subSpectrum;
+        inputQueue.waitAndPop(subSpectrum);
 
-        startTimer(TIMER_AVERAGE);
-        std::vector<double> magData = *magDataPointer;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-        // Immediately unpack the data into a growing vector of subSpectra
-        subSpectra.push_back(magData);
-        dataProcessor.addRawSpectrumToRunningAverage(magData);
+        // Immediately unpack the data into a growing vector of subSpectra (empty data only arrives as the final of an unexpected exit)
+        if (!subSpectrum.powers.empty()) {
+            traceEvent(subSpectrum.tag, TRACE_AVERAGE, TRACE_DEQUEUE);
+            averagedTag = subSpectra.empty() ? subSpectrum.tag : mergeTags(averagedTag, subSpectrum.tag);
+
+            dataProcessor.addRawSpectrumToRunningAverage(subSpectrum.powers);
+            subSpectra.push_back(std::move(subSpectrum.powers));
+        }
 
         // If the subSpectra vector is ready, average it and push it to the output queue
         if (subSpectra.size() == subSpectraAveragingNumber || (inputQueue.isInputComplete() && inputQueue.empty())) {
             Spectrum rawSpectrum;
-            rawSpectrum.powers = averageVectors(subSpectra);
-            rawSpectrum.freqAxis = dataProcessor.SNR.freqAxis;
+            if (!subSpectra.empty()) {
+                rawSpectrum.powers = averageVectors(subSpectra);
+                rawSpectrum.freqAxis = dataProcessor.SNR.freqAxis;
+                rawSpectrum.tag = averagedTag;
+
+                traceEvent(rawSpectrum.tag, TRACE_AVERAGE, TRACE_FINISH);
+                traceEvent(rawSpectrum.tag, TRACE_PROCESS, TRACE_ENQUEUE);
+            }
             rawSpectrum.trueCenterFreq = trueCenterFreq;
 
             subSpectraAveraged += (int)subSpectra.size();
@@ -80,7 +317,7 @@ void averagingThread(DataProcessor& dataProcessor, double trueCenterFreq,
             subSpectra.clear();
 
             if (inputQueue.isInputComplete() && inputQueue.empty()) {
-                stopTimer(TIMER_AVERAGE);
+                addTime(TIMER_AVERAGE, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
                 outputQueue.pushFinal(rawSpectrum);
 
                 setMetric(ACQUIRED_SPECTRA, subSpectraAveraged);
@@ -91,17 +328,23 @@ void averagingThread(DataProcessor& dataProcessor, double trueCenterFreq,
                 outputQueue.push(rawSpectrum);
             }
         }
-        stopTimer(TIMER_AVERAGE);
+        addTime(TIMER_AVERAGE, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
     }
 }
 
 
-void processingThread(DataProcessor& dataProcessor, ThreadSafeQueue<Spectrum>& inputQueue, ThreadSafeQueue<CombinedSpectrum>& outputQueue) {
+void processingThread(DataProcessor& dataProcessor, PipelineQueue<Spectrum>& inputQueue, PipelineQueue<CombinedSpectrum>& outputQueue) {
     while (true) {
-        std::shared_ptr<Spectrum> rawSpectrumPointer = inputQueue.waitAndPop();
+        Spectrum rawSpectrum;
+        inputQueue.waitAndPop(rawSpectrum);
+
+        if (rawSpectrum.powers.empty()) {
+            outputQueue.pushFinal(CombinedSpectrum());
+            break;
+        }
+        traceEvent(rawSpectrum.tag, TRACE_PROCESS, TRACE_DEQUEUE);
 
-        startTimer(TIMER_PROCESS);
-        Spectrum rawSpectrum = *rawSpectrumPointer;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
         // Main processing logic
         Spectrum processedSpectrum, foo;
@@ -116,8 +359,11 @@ void processingThread(DataProcessor& dataProcessor, ThreadSafeQueue<Spectrum>& i
         dataProcessor.addRescaledToCombined(rescaledSpectrum, combinedSpectrum);
 
         CombinedSpectrum rebinnedSpectrum = dataProcessor.rebinCombinedSpectrum(combinedSpectrum, 10, 1);
+        rebinnedSpectrum.tag = rawSpectrum.tag;
 
-        stopTimer(TIMER_PROCESS);
+        addTime(TIMER_PROCESS, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        traceEvent(rebinnedSpectrum.tag, TRACE_PROCESS, TRACE_FINISH);
+        traceEvent(rebinnedSpectrum.tag, TRACE_DECISION, TRACE_ENQUEUE);
 
         if (inputQueue.isInputComplete() && inputQueue.empty()) {
             outputQueue.pushFinal(rebinnedSpectrum);
@@ -130,16 +376,27 @@ void processingThread(DataProcessor& dataProcessor, ThreadSafeQueue<Spectrum>& i
 }
 
 
-void decisionMakingThread(BayesFactors& bayesFactors, DecisionAgent& decisionAgent, ThreadSafeQueue<CombinedSpectrum>& inputQueue, std::atomic<bool>& triggerEnd) {
+void decisionMakingThread(BayesFactors& bayesFactors, DecisionAgent& decisionAgent, PipelineQueue<CombinedSpectrum>& inputQueue, std::atomic<bool>& triggerEnd) {
+    static MetricCounter& decidedSpectra = metricsRegistry().counter("decision_spectra_total", "Spectra folded into the exclusion line");
+    static MetricCounter& decisions = metricsRegistry().counter("decisions_total", "Steps ended early by the decision agent");
+    static MetricGauge& decisionScore = metricsRegistry().gauge("decision_score", "Running decision score after the last spectrum");
+
     setMetric(SPECTRA_AT_DECISION, -1);
     
     int spectraDecided = 0;
 
     while (true) {
-        std::shared_ptr<CombinedSpectrum> rebinnedSpectrumPointer = inputQueue.waitAndPop();
+        CombinedSpectrum rebinnedSpectrum;
+        inputQueue.waitAndPop(rebinnedSpectrum);
+
+        if (rebinnedSpectrum.powers.empty()) {
+            updateMetric(SPECTRA_AT_DECISION, spectraDecided);
+            break;
+        }
+        traceEvent(rebinnedSpectrum.tag, TRACE_DECISION, TRACE_DEQUEUE);
 
         startTimer(TIMER_DECISION);
-        CombinedSpectrum rebinnedSpectrum = *rebinnedSpectrumPointer;
+        decidedSpectra.add();
 
         if (decisionAgent.trimmedSNR.powers.empty()) {
             decisionAgent.resizeSNRtoMatch(rebinnedSpectrum);
@@ -148,19 +405,22 @@ void decisionMakingThread(BayesFactors& bayesFactors, DecisionAgent& decisionAge
         }
 
         bayesFactors.updateExclusionLine(rebinnedSpectrum);
+        decisionAgent.updateScore(bayesFactors);
 
         if (!triggerEnd.load()){
             spectraDecided++;
 
-            std::vector<double> activeWindow(bayesFactors.exclusionLine.powers.end() - decisionAgent.trimmedSNR.powers.size(), bayesFactors.exclusionLine.powers.end());
-            int decision = decisionAgent.getDecision(activeWindow, spectraDecided);
+            int decision = decisionAgent.getDecision(spectraDecided);
 
 
             if (decision) {
                 triggerEnd = true;
+                decisions.add();
             }
         }
+        decisionScore.set(decisionAgent.getScore());
         stopTimer(TIMER_DECISION);
+        traceEvent(rebinnedSpectrum.tag, TRACE_DECISION, TRACE_FINISH);
 
 
         if (inputQueue.isInputComplete() && inputQueue.empty()) {
@@ -0,0 +1,249 @@
+/**
+ * @file platform.cpp
+ * @author your name (you@domain.com)
+ * @brief Thin platform layer. Everything that differs between the Windows acquisition host and the Linux analysis nodes (console input,
+ *        folder listing, local time, file syncing and replacing, worker thread settings) is implemented here, so the rest of the core library
+ *        builds unchanged on both.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+/**
+ * @brief Whether a key press is waiting on the console, without blocking. Away from Windows the terminal is line buffered, so this only
+ * turns true once Enter is pressed, and never when the input isn't a terminal (a batch job reading from a file or /dev/null).
+ *
+ */
+bool keyPressed() {
+#ifdef _WIN32
+    return _kbhit() != 0;
+#else
+    if (!isatty(STDIN_FILENO)) {
+        return false;
+    }
+
+    fd_set input;
+    FD_ZERO(&input);
+    FD_SET(STDIN_FILENO, &input);
+
+    timeval timeout = {0, 0};
+    return select(STDIN_FILENO + 1, &input, nullptr, nullptr, &timeout) > 0;
+#endif
+}
+
+
+
+/**
+ * @brief Names of the regular files in a folder, without the folder. Subfolders, "." and ".." are skipped.
+ *
+ * @param folderPath - Folder to list, with or without a trailing separator
+ * @param files - Filled with the file names in no particular order. Left empty if the folder can't be opened
+ * @return bool - Whether the folder could be opened. Failures are also reported on stderr
+ */
+bool listFiles(const std::string& folderPath, std::vector<std::string>& files) {
+    files.clear();
+
+#ifdef _WIN32
+    WIN32_FIND_DATA findFileData;
+    HANDLE hFind = FindFirstFile((folderPath + "\\*").c_str(), &findFileData);
+
+    if (hFind == INVALID_HANDLE_VALUE) {
+        std::cerr << "FindFirstFile failed. Error: " << GetLastError() << std::endl;
+        return false;
+    }
+
+    do {
+        if (!(findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            files.push_back(findFileData.cFileName);
+        }
+    } while (FindNextFile(hFind, &findFileData) != 0);
+
+    FindClose(hFind);
+#else
+    DIR* directory = opendir(folderPath.c_str());
+    if (directory == nullptr) {
+        std::cerr << "Unable to open folder " << folderPath << ". Error: " << errno << std::endl;
+        return false;
+    }
+
+    while (dirent* entry = readdir(directory)) {
+        struct stat info;
+        if (stat((folderPath + "/" + entry->d_name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+            files.push_back(entry->d_name);
+        }
+    }
+
+    closedir(directory);
+#endif
+
+    return true;
+}
+
+
+
+/**
+ * @brief Thread safe conversion of a time to the local calendar time.
+ *
+ */
+std::tm localTime(std::time_t time) {
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+    return local;
+}
+
+
+
+/**
+ * @brief Flushes a file and waits for the operating system to write it to disk.
+ *
+ */
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+
+
+/**
+ * @brief Cuts a file down to its first bytes. The file position is left where it was.
+ *
+ */
+bool truncateFile(std::FILE* file, std::uint64_t bytes) {
+    std::fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), (long long)bytes) == 0;
+#else
+    return ftruncate(fileno(file), (off_t)bytes) == 0;
+#endif
+}
+
+
+
+/**
+ * @brief Atomically replaces target with source, so a reader sees either the old or the new file and never half of one.
+ *
+ * @param source - File to move
+ * @param target - File to replace, created if it doesn't exist
+ * @param durable - Also wait for the rename to reach the disk, for files that must survive a power cut
+ * @return bool - Whether the rename happened. The durability wait is best effort
+ */
+bool replaceFile(std::string const& source, std::string const& target, bool durable) {
+#ifdef _WIN32
+    DWORD flags = durable ? (MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) : MOVEFILE_REPLACE_EXISTING;
+    return MoveFileExA(source.c_str(), target.c_str(), flags) != 0;
+#else
+    if (std::rename(source.c_str(), target.c_str()) != 0) {
+        return false;
+    }
+
+    // The rename lives in the folder, so that is what has to be synced
+    if (durable) {
+        size_t separator = target.find_last_of("/\\");
+        std::string directory = (separator == std::string::npos) ? "." : target.substr(0, separator + 1);
+
+        int fd = ::open(directory.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            fsync(fd);
+            ::close(fd);
+        }
+    }
+    return true;
+#endif
+}
+
+
+
+#ifndef _WIN32
+/**
+ * @brief Affinity of the process, read while the library loads on the main thread. Later calls to sched_getaffinity only see the calling
+ * thread's own mask, which is already narrowed once a worker has been pinned.
+ *
+ */
+static cpu_set_t readProcessAffinity() {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    return cpus;
+}
+
+static const cpu_set_t processAffinity = readProcessAffinity();
+#endif
+
+
+
+/**
+ * @brief Pins the calling thread to the CPUs of a mask.
+ *
+ * @param affinityMask - Bit n set for logical CPU n. 0 goes back to every CPU of the process
+ */
+bool setThreadAffinity(unsigned long long affinityMask) {
+#ifdef _WIN32
+    DWORD_PTR mask = (DWORD_PTR)affinityMask;
+    if (mask == 0) {
+        DWORD_PTR systemMask;
+        GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask);
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    cpu_set_t cpus = processAffinity;
+    if (affinityMask != 0) {
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+            if (affinityMask & (1ULL << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#endif
+}
+
+
+
+/**
+ * @brief Sets the priority of the calling thread. Only applied on Windows, elsewhere raising it needs privileges the analysis nodes don't
+ * give, so it reports success and leaves the priority alone.
+ *
+ * @param priority - WORKER_PRIORITY_* code
+ */
+bool setThreadPriority(int priority) {
+#ifdef _WIN32
+    return SetThreadPriority(GetCurrentThread(), priority) != 0;
+#else
+    (void)priority;
+    return true;
+#endif
+}
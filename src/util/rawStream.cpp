@@ -0,0 +1,240 @@
+/**
+ * @file rawStream.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for RawStreamRecorder and RawStreamReplay. See include\utils\rawStream.hpp for class definitions.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+static_assert(sizeof(RawStreamHeader) == 64, "RawStreamHeader must stay 64 bytes, it is the on-disk layout");
+
+
+RawStreamRecorder::RawStreamRecorder() : file(nullptr), bufferSamples(0), buffersWritten(0), writeFailed(false) {}
+
+RawStreamRecorder::~RawStreamRecorder() {
+    stop();
+}
+
+
+
+/**
+ * @brief Opens filename, writes the header and starts the writer thread. Stops any recording already in progress.
+ *
+ * @param filename - File to create. Overwritten if it exists
+ * @param acquisitionParams - Geometry of the buffers that will be recorded
+ * @param queueCapacity - Buffers that can wait for the disk before record() blocks
+ */
+void RawStreamRecorder::start(std::string const& filename, AcquisitionParameters const& acquisitionParams, int queueCapacity) {
+    stop();
+
+    file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Error: Unable to open raw stream file " + filename);
+    }
+    this->filename = filename;
+
+    // Large stdio buffer, the writes are already one DMA buffer each
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RAW_STREAM_MAGIC, sizeof(header.magic));
+    header.version = RAW_STREAM_VERSION;
+    header.channelCount = 2;
+    header.samplesPerBuffer = acquisitionParams.samplesPerBuffer;
+    header.bytesPerSample = sizeof(U16);
+    header.sampleRate = acquisitionParams.sampleRate;
+    header.inputRange = acquisitionParams.inputRange;
+    header.bufferCount = 0;
+
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::fclose(file);
+        file = nullptr;
+        throw std::runtime_error("Error: Unable to write raw stream header to " + filename);
+    }
+
+    bufferSamples = (size_t)header.channelCount*header.samplesPerBuffer;
+    buffersWritten = 0;
+    writeFailed = false;
+
+    // Every block is either being filled, queued, being written or waiting to be recycled, so the recycle queue never fills
+    writeQueue.reset(new SPSCQueue<std::vector<U16>>(queueCapacity, QUEUE_BLOCK));
+    recycleQueue.reset(new SPSCQueue<std::vector<U16>>(writeQueue->getCapacity() + 2, QUEUE_BLOCK));
+
+    writerThread = std::thread(&RawStreamRecorder::writeBuffers, this);
+}
+
+
+
+/**
+ * @brief Queues one DMA buffer for writing. Copies channelCount*samplesPerBuffer codes out of dmaBuffer, so the buffer can be posted back to
+ * the board as soon as this returns. Does nothing if the recorder isn't started.
+ *
+ * @param dmaBuffer - DMA buffer as filled by the board
+ */
+void RawStreamRecorder::record(const void* dmaBuffer) {
+    if (!isRecording()) {
+        return;
+    }
+
+    std::vector<U16> block;
+    if (!recycleQueue->tryPop(block)) {
+        block.resize(bufferSamples);
+    }
+    std::memcpy(block.data(), dmaBuffer, bufferSamples*sizeof(U16));
+
+    writeQueue->push(std::move(block));
+}
+
+
+
+/**
+ * @brief Waits for the writer to drain the queue, then fills in the buffer count in the header and closes the file. Safe to call when not
+ * recording.
+ *
+ */
+void RawStreamRecorder::stop() {
+    if (!isRecording()) {
+        return;
+    }
+
+    writeQueue->pushFinal(std::vector<U16>());
+    writerThread.join();
+
+    header.bufferCount = buffersWritten;
+    if (!writeFailed.load()) {
+        std::fseek(file, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, file);
+    }
+    std::fclose(file);
+    file = nullptr;
+
+    QueueStats stats = writeQueue->getStats();
+    std::cout << "Recorded " << buffersWritten << " raw buffers (" << buffersWritten*bufferSamples*sizeof(U16)/1e6 << " MB) to " << filename;
+    if (stats.pushBlockedTime > 0) {
+        std::cout << ", acquisition waited " << stats.pushBlockedTime << " s on the disk";
+    }
+    std::cout << std::endl;
+
+    if (writeFailed.load()) {
+        std::cout << "Error: Writing " << filename << " failed, the recording is incomplete" << std::endl;
+    }
+
+    writeQueue.reset();
+    recycleQueue.reset();
+}
+
+
+
+/**
+ * @brief Writer thread. Writes blocks in order until the final (empty) block and hands each one back for reuse. After a failed write the
+ * remaining blocks are drained without writing so record() never waits on a dead disk.
+ *
+ */
+void RawStreamRecorder::writeBuffers() {
+    while (true) {
+        std::vector<U16> block;
+        writeQueue->waitAndPop(block);
+
+        if (!block.empty() && !writeFailed.load()) {
+            if (std::fwrite(block.data(), sizeof(U16), block.size(), file) == block.size()) {
+                buffersWritten++;
+            }
+            else {
+                writeFailed = true;
+            }
+        }
+
+        if (writeQueue->isInputComplete() && writeQueue->empty()) {
+            break;
+        }
+
+        if (!block.empty()) {
+            recycleQueue->push(std::move(block));
+        }
+    }
+
+    std::fflush(file);
+}
+
+
+
+RawStreamReplay::RawStreamReplay() {}
+
+RawStreamReplay::~RawStreamReplay() {
+    close();
+}
+
+
+
+/**
+ * @brief Maps filename read only and checks its header. Every page is touched once so the first pass of a replay runs from memory rather than
+ * from the disk.
+ *
+ * @param filename - Raw stream file written by RawStreamRecorder
+ */
+void RawStreamReplay::open(std::string const& filename) {
+    close();
+
+    file.open(filename);
+    this->filename = filename;
+
+    const char* mapping = file.data();
+    size_t mappedBytes = file.size();
+
+
+    // Check the header
+    if (mappedBytes < sizeof(RawStreamHeader)) {
+        close();
+        throw std::runtime_error("Error: " + filename + " is too short to be a raw stream file");
+    }
+    std::memcpy(&header, mapping, sizeof(header));
+
+    if (std::memcmp(header.magic, RAW_STREAM_MAGIC, sizeof(header.magic)) != 0 || header.version != RAW_STREAM_VERSION) {
+        close();
+        throw std::runtime_error("Error: " + filename + " is not a version " + std::to_string(RAW_STREAM_VERSION) + " raw stream file");
+    }
+
+    size_t bytesPerBuffer = (size_t)header.channelCount*header.samplesPerBuffer*header.bytesPerSample;
+    unsigned long long buffersInFile = (bytesPerBuffer > 0) ? (mappedBytes - sizeof(RawStreamHeader))/bytesPerBuffer : 0;
+
+    // A recording that wasn't stopped cleanly has no count, use every whole buffer in the file
+    if (header.bufferCount == 0 || header.bufferCount > buffersInFile) {
+        header.bufferCount = buffersInFile;
+    }
+    if (header.bufferCount == 0) {
+        close();
+        throw std::runtime_error("Error: " + filename + " holds no complete buffers");
+    }
+
+
+    // Fault every page in now
+    volatile char touch = 0;
+    for (size_t offset = 0; offset < mappedBytes; offset += 4096) {
+        touch ^= mapping[offset];
+    }
+}
+
+
+
+void RawStreamReplay::close() {
+    file.close();
+    filename.clear();
+}
+
+
+
+/**
+ * @brief Pointer to buffer index of the file, channel A followed by channel B.
+ *
+ * @param index - Buffer number, must be below getBufferCount()
+ * @return const U16* - channelCount*samplesPerBuffer codes, valid until the file is closed
+ */
+const U16* RawStreamReplay::buffer(unsigned long long index) const {
+    size_t bytesPerBuffer = (size_t)header.channelCount*header.samplesPerBuffer*header.bytesPerSample;
+    return reinterpret_cast<const U16*>(file.data() + sizeof(RawStreamHeader) + index*bytesPerBuffer);
+}
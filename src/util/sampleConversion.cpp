@@ -0,0 +1,176 @@
+/**
+ * @file sampleConversion.cpp
+ * @author your name (you@domain.com)
+ * @brief Conversion of raw ATS9462 sample codes into the complex voltage stream fed to FFTW, in double or single precision.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * @note The AVX2 path is used when the project is built with ENABLE_AVX2 (/arch:AVX2 or -mavx2), otherwise SSE2 on any x86-64 target, and
+ * a plain scalar loop everywhere else. All three give the same result up to the last bit of the scale multiply.
+ *
+ */
+
+#include "decs.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAMPLE_CONVERSION_SSE2
+#include <emmintrin.h>
+#endif
+
+
+/**
+ * @brief Converts one buffer of channel A and B sample codes into interleaved complex voltages, applying the alternating sign trick that
+ * centers the DFT at 0.
+ *
+ * @details Sample codes are unsigned: 0x0000 is negative full scale, 0x8000 is 0V and 0xFFFF is positive full scale. Sample i of the output is
+ * (A_i + jB_i) in volts, multiplied by (-1)^(firstIndex + i). The sign is applied with a precomputed sign mask (xor of the sign bit) rather
+ * than a branch on the sample parity.
+ *
+ * @param samplesA - numSamples channel A codes (first half of an ATS DMA buffer)
+ * @param samplesB - numSamples channel B codes (second half of an ATS DMA buffer)
+ * @param output - destination, numSamples fftw_complex. Does not need to be aligned.
+ * @param numSamples - number of samples per channel to convert
+ * @param inputRange - full scale voltage range of the acquisition
+ * @param firstIndex - index of the first sample in the overall stream, only its parity matters
+ */
+void convertSamplesToComplex(const U16* samplesA, const U16* samplesB, fftw_complex* output, U32 numSamples, double inputRange, U32 firstIndex) {
+    const double scale = 2*inputRange/(double)0xFFFF;
+    U32 i = 0;
+
+#if defined(__AVX2__)
+    const __m256d scaleVec = _mm256_set1_pd(scale);
+    const __m256d offsetVec = _mm256_set1_pd(inputRange);
+
+    // Each vector holds [A_i, B_i, A_i+1, B_i+1] with i stepping by 2, so the sign pattern is the same for every vector
+    const __m256d signMask = (firstIndex % 2 == 0) ? _mm256_set_pd(-0.0, -0.0, 0.0, 0.0) : _mm256_set_pd(0.0, 0.0, -0.0, -0.0);
+
+    for (; i + 4 <= numSamples; i += 4) {
+        __m256d a = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samplesA + i))));
+        __m256d b = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samplesB + i))));
+
+        a = _mm256_sub_pd(_mm256_mul_pd(a, scaleVec), offsetVec);
+        b = _mm256_sub_pd(_mm256_mul_pd(b, scaleVec), offsetVec);
+
+        // Interleave into complex pairs: lo = [A0, B0, A2, B2], hi = [A1, B1, A3, B3]
+        __m256d lo = _mm256_unpacklo_pd(a, b);
+        __m256d hi = _mm256_unpackhi_pd(a, b);
+
+        __m256d first = _mm256_permute2f128_pd(lo, hi, 0x20);   // [A0, B0, A1, B1]
+        __m256d second = _mm256_permute2f128_pd(lo, hi, 0x31);  // [A2, B2, A3, B3]
+
+        _mm256_storeu_pd(&output[i][0], _mm256_xor_pd(first, signMask));
+        _mm256_storeu_pd(&output[i + 2][0], _mm256_xor_pd(second, signMask));
+    }
+
+#elif defined(SAMPLE_CONVERSION_SSE2)
+    const __m128d scaleVec = _mm_set1_pd(scale);
+    const __m128d offsetVec = _mm_set1_pd(inputRange);
+    const __m128i zero = _mm_setzero_si128();
+
+    // Each vector holds one complex sample [A_i, B_i], so even and odd samples get their own mask
+    const __m128d evenMask = (firstIndex % 2 == 0) ? _mm_set1_pd(0.0) : _mm_set1_pd(-0.0);
+    const __m128d oddMask = (firstIndex % 2 == 0) ? _mm_set1_pd(-0.0) : _mm_set1_pd(0.0);
+
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128i codesA = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samplesA + i)), zero);
+        __m128i codesB = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samplesB + i)), zero);
+
+        __m128d a01 = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(codesA), scaleVec), offsetVec);
+        __m128d a23 = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(codesA, _MM_SHUFFLE(3, 2, 3, 2))), scaleVec), offsetVec);
+        __m128d b01 = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(codesB), scaleVec), offsetVec);
+        __m128d b23 = _mm_sub_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(codesB, _MM_SHUFFLE(3, 2, 3, 2))), scaleVec), offsetVec);
+
+        _mm_storeu_pd(&output[i][0],     _mm_xor_pd(_mm_unpacklo_pd(a01, b01), evenMask));
+        _mm_storeu_pd(&output[i + 1][0], _mm_xor_pd(_mm_unpackhi_pd(a01, b01), oddMask));
+        _mm_storeu_pd(&output[i + 2][0], _mm_xor_pd(_mm_unpacklo_pd(a23, b23), evenMask));
+        _mm_storeu_pd(&output[i + 3][0], _mm_xor_pd(_mm_unpackhi_pd(a23, b23), oddMask));
+    }
+#endif
+
+    // Scalar fallback and tail
+    const double signs[2] = {1.0, -1.0};
+    for (; i < numSamples; i++) {
+        double sign = signs[(firstIndex + i) & 1];
+
+        output[i][0] = sign*(samplesA[i]*scale - inputRange);
+        output[i][1] = sign*(samplesB[i]*scale - inputRange);
+    }
+}
+
+
+
+/**
+ * @brief Single precision version of convertSamplesToComplex for the float pipeline (SINGLE_PRECISION_PIPELINE). A 16 bit code is exact in a
+ * float, so the only extra error is the float rounding of the scale multiply, about 1e-7 of full scale.
+ *
+ * @param samplesA - numSamples channel A codes (first half of an ATS DMA buffer)
+ * @param samplesB - numSamples channel B codes (second half of an ATS DMA buffer)
+ * @param output - destination, numSamples fftwf_complex. Does not need to be aligned.
+ * @param numSamples - number of samples per channel to convert
+ * @param inputRange - full scale voltage range of the acquisition
+ * @param firstIndex - index of the first sample in the overall stream, only its parity matters
+ */
+void convertSamplesToComplex(const U16* samplesA, const U16* samplesB, fftwf_complex* output, U32 numSamples, double inputRange, U32 firstIndex) {
+    const float scale = (float)(2*inputRange/(double)0xFFFF);
+    const float offset = (float)inputRange;
+    U32 i = 0;
+
+#if defined(__AVX2__)
+    const __m256 scaleVec = _mm256_set1_ps(scale);
+    const __m256 offsetVec = _mm256_set1_ps(offset);
+
+    // Each vector holds four complex samples [A_i, B_i, ..., A_i+3, B_i+3] with i stepping by 4, so the sign pattern is the same for every vector
+    const __m256 signMask = (firstIndex % 2 == 0) ? _mm256_set_ps(-0.0f, -0.0f, 0.0f, 0.0f, -0.0f, -0.0f, 0.0f, 0.0f)
+                                                  : _mm256_set_ps(0.0f, 0.0f, -0.0f, -0.0f, 0.0f, 0.0f, -0.0f, -0.0f);
+
+    for (; i + 8 <= numSamples; i += 8) {
+        __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samplesA + i))));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samplesB + i))));
+
+        a = _mm256_sub_ps(_mm256_mul_ps(a, scaleVec), offsetVec);
+        b = _mm256_sub_ps(_mm256_mul_ps(b, scaleVec), offsetVec);
+
+        // Interleave into complex pairs: lo = [A0, B0, A1, B1, A4, B4, A5, B5], hi = [A2, B2, A3, B3, A6, B6, A7, B7]
+        __m256 lo = _mm256_unpacklo_ps(a, b);
+        __m256 hi = _mm256_unpackhi_ps(a, b);
+
+        __m256 first = _mm256_permute2f128_ps(lo, hi, 0x20);   // [A0, B0, ..., A3, B3]
+        __m256 second = _mm256_permute2f128_ps(lo, hi, 0x31);  // [A4, B4, ..., A7, B7]
+
+        _mm256_storeu_ps(&output[i][0], _mm256_xor_ps(first, signMask));
+        _mm256_storeu_ps(&output[i + 4][0], _mm256_xor_ps(second, signMask));
+    }
+
+#elif defined(SAMPLE_CONVERSION_SSE2)
+    const __m128 scaleVec = _mm_set1_ps(scale);
+    const __m128 offsetVec = _mm_set1_ps(offset);
+    const __m128i zero = _mm_setzero_si128();
+
+    // Each vector holds two complex samples [A_i, B_i, A_i+1, B_i+1] with i stepping by 2, so one mask covers every vector
+    const __m128 signMask = (firstIndex % 2 == 0) ? _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f) : _mm_set_ps(0.0f, 0.0f, -0.0f, -0.0f);
+
+    for (; i + 4 <= numSamples; i += 4) {
+        __m128 a = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samplesA + i)), zero));
+        __m128 b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(samplesB + i)), zero));
+
+        a = _mm_sub_ps(_mm_mul_ps(a, scaleVec), offsetVec);
+        b = _mm_sub_ps(_mm_mul_ps(b, scaleVec), offsetVec);
+
+        _mm_storeu_ps(&output[i][0],     _mm_xor_ps(_mm_unpacklo_ps(a, b), signMask));
+        _mm_storeu_ps(&output[i + 2][0], _mm_xor_ps(_mm_unpackhi_ps(a, b), signMask));
+    }
+#endif
+
+    // Scalar fallback and tail
+    const float signs[2] = {1.0f, -1.0f};
+    for (; i < numSamples; i++) {
+        float sign = signs[(firstIndex + i) & 1];
+
+        output[i][0] = sign*(samplesA[i]*scale - offset);
+        output[i][1] = sign*(samplesB[i]*scale - offset);
+    }
+}
@@ -0,0 +1,515 @@
+/**
+ * @file stateJournal.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for StateJournal. See include\utils\stateJournal.hpp for the class definition and file layout.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+static_assert(sizeof(StateFileHeader) == 16, "StateFileHeader must stay 16 bytes, it is the on-disk layout");
+static_assert(sizeof(StateRecordHeader) == 80, "StateRecordHeader must stay 80 bytes, it is the on-disk layout");
+
+
+/*******************************************************************************
+ *                                                                            *
+ * FILE HELPERS                                                               *
+ *                                                                            *
+ ******************************************************************************/
+
+// CRC-32 (IEEE 802.3), continued from crc
+static std::uint32_t crc32(std::uint32_t crc, const void* data, size_t bytes) {
+    static std::uint32_t table[256];
+    static bool tableReady = [] {
+        for (std::uint32_t n = 0; n < 256; n++) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)tableReady;
+
+    const unsigned char* bytePtr = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < bytes; i++) {
+        crc = table[(crc ^ bytePtr[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static bool fileExists(std::string const& filename) {
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fclose(file);
+    return true;
+}
+
+static StateFileHeader makeHeader(const char* magic) {
+    StateFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = STATE_JOURNAL_VERSION;
+    return header;
+}
+
+static bool hasHeader(MappedFile const& file, const char* magic) {
+    if (file.size() < sizeof(StateFileHeader)) {
+        return false;
+    }
+
+    StateFileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    return std::memcmp(header.magic, magic, sizeof(header.magic)) == 0 && header.version == STATE_JOURNAL_VERSION;
+}
+
+// Writes one record of bins [firstBin, totalBins) of snapshot
+static bool writeRecord(std::FILE* file, StateSnapshot const& snapshot, std::uint64_t sequence) {
+    StateRecordHeader record;
+    std::memset(&record, 0, sizeof(record));
+    record.binCount = (std::uint32_t)snapshot.exclusionLine.powers.size();
+    record.sequence = sequence;
+    record.firstBin = snapshot.firstBin;
+    record.totalBins = snapshot.totalBins;
+    record.baseIndex = snapshot.baseIndex;
+    record.startIndex = snapshot.startIndex;
+    record.cutoffIndex = snapshot.cutoffIndex;
+    record.freqRes = snapshot.freqRes;
+    record.trueCenterFreq = snapshot.trueCenterFreq;
+
+    const std::vector<double>* columns[4] = {&snapshot.exclusionLine.powers, &snapshot.exclusionLine.freqAxis, &snapshot.coeffSumA, &snapshot.coeffSumB};
+    size_t columnBytes = record.binCount*sizeof(double);
+
+    std::uint32_t crc = crc32(0, reinterpret_cast<const char*>(&record) + sizeof(record.crc), sizeof(record) - sizeof(record.crc));
+    for (const std::vector<double>* column : columns) {
+        crc = crc32(crc, column->data(), columnBytes);
+    }
+    record.crc = crc;
+
+    if (std::fwrite(&record, sizeof(record), 1, file) != 1) {
+        return false;
+    }
+    for (const std::vector<double>* column : columns) {
+        if (record.binCount > 0 && std::fwrite(column->data(), sizeof(double), record.binCount, file) != record.binCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Walks the records of a mapped file from offset until the end or the first record that is cut short, fails its CRC or doesn't fit on
+ * the window so far. Records with a sequence above minSequence are applied to the window in state.
+ *
+ * @return size_t - Offset just past the last good record
+ */
+static size_t readRecords(MappedFile const& file, size_t offset, std::uint64_t minSequence, StateSnapshot& state, std::uint64_t& lastSequence, bool& applied) {
+    const char* data = file.data();
+    size_t size = file.size();
+
+    while (offset + sizeof(StateRecordHeader) <= size) {
+        StateRecordHeader record;
+        std::memcpy(&record, data + offset, sizeof(record));
+
+        size_t columnBytes = (size_t)record.binCount*sizeof(double);
+        size_t recordBytes = sizeof(record) + 4*columnBytes;
+        if (offset + recordBytes > size || record.firstBin < record.baseIndex || record.firstBin + record.binCount > record.totalBins) {
+            break;
+        }
+        if (crc32(0, data + offset + sizeof(record.crc), recordBytes - sizeof(record.crc)) != record.crc) {
+            break;
+        }
+
+        if (record.sequence > minSequence) {
+            std::vector<double>* columns[4] = {&state.exclusionLine.powers, &state.exclusionLine.freqAxis, &state.coeffSumA, &state.coeffSumB};
+
+            if (record.firstBin == record.baseIndex) {
+                // Whole window
+                for (std::vector<double>* target : columns) {
+                    target->clear();
+                }
+            }
+            else if (record.baseIndex < state.baseIndex) {
+                break;
+            }
+            else {
+                // Bins that left the window since the last record
+                size_t finalized = (size_t)(record.baseIndex - state.baseIndex);
+                finalized = (finalized < state.coeffSumA.size()) ? finalized : state.coeffSumA.size();
+                for (std::vector<double>* target : columns) {
+                    target->erase(target->begin(), target->begin() + finalized);
+                }
+            }
+
+            // Bins past the old end that the record doesn't cover (none in practice) start out like BayesFactors::step leaves them
+            size_t windowBins = (size_t)(record.totalBins - record.baseIndex);
+            state.exclusionLine.powers.resize(windowBins, 100);
+            state.exclusionLine.freqAxis.resize(windowBins, 0);
+            state.coeffSumA.resize(windowBins, 0);
+            state.coeffSumB.resize(windowBins, 0);
+
+            const char* column = data + offset + sizeof(record);
+            for (std::vector<double>* target : columns) {
+                if (columnBytes > 0) {
+                    std::memcpy(target->data() + (record.firstBin - record.baseIndex), column, columnBytes);
+                }
+                column += columnBytes;
+            }
+
+            state.baseIndex = (size_t)record.baseIndex;
+            state.totalBins = (size_t)record.totalBins;
+            state.freqRes = record.freqRes;
+            state.startIndex = (int)record.startIndex;
+            state.cutoffIndex = (int)record.cutoffIndex;
+            state.trueCenterFreq = record.trueCenterFreq;
+            applied = true;
+        }
+
+        lastSequence = (record.sequence > lastSequence) ? record.sequence : lastSequence;
+        offset += recordBytes;
+    }
+
+    return offset;
+}
+
+/**
+ * @brief Rebuilds the window of statePath from the snapshot and the journal records written after it.
+ *
+ * @param statePath - State directory, with a trailing separator
+ * @param state - Receives the window
+ * @param lastSequence - Receives the newest sequence number seen
+ * @param journalBytes - Receives the length of the good part of the journal, 0 if it has no valid header
+ * @return bool - Whether any record was applied
+ */
+static bool replayState(std::string const& statePath, StateSnapshot& state, std::uint64_t& lastSequence, size_t& journalBytes) {
+    bool applied = false;
+    lastSequence = 0;
+    journalBytes = 0;
+
+    std::string snapshotFilename = statePath + STATE_SNAPSHOT_FILE;
+    if (fileExists(snapshotFilename)) {
+        MappedFile snapshot;
+        snapshot.open(snapshotFilename);
+        if (!hasHeader(snapshot, STATE_SNAPSHOT_MAGIC)) {
+            throw std::runtime_error("Error: " + snapshotFilename + " is not a version " + std::to_string(STATE_JOURNAL_VERSION) + " state snapshot");
+        }
+        readRecords(snapshot, sizeof(StateFileHeader), 0, state, lastSequence, applied);
+        if (!applied) {
+            throw std::runtime_error("Error: " + snapshotFilename + " is corrupt");
+        }
+    }
+
+    std::string journalFilename = statePath + STATE_JOURNAL_FILE;
+    if (fileExists(journalFilename)) {
+        MappedFile journal;
+        try {
+            journal.open(journalFilename);
+        }
+        catch (std::runtime_error const&) {
+            // Empty, nothing was written to it
+        }
+        if (journal.isOpen() && hasHeader(journal, STATE_JOURNAL_MAGIC)) {
+            journalBytes = readRecords(journal, sizeof(StateFileHeader), lastSequence, state, lastSequence, applied);
+        }
+    }
+
+    return applied;
+}
+
+
+
+/*******************************************************************************
+ *                                                                            *
+ * STATE JOURNAL                                                              *
+ *                                                                            *
+ ******************************************************************************/
+
+StateJournal::StateJournal() : file(nullptr), segmentFile(nullptr), nextSequence(1), segmentBins(0) {}
+
+StateJournal::~StateJournal() {
+    close();
+}
+
+
+
+/**
+ * @brief Opens the journal and segment file of statePath for appending, creating them if needed. A torn record left at the end of the journal
+ * by a crash is cut off, as are finalized bins the journal doesn't know about yet, and the sequence carries on from the newest record.
+ *
+ * @param statePath - State directory, with a trailing separator
+ */
+void StateJournal::open(std::string const& statePath) {
+    close();
+
+    std::string journalFilename = statePath + STATE_JOURNAL_FILE;
+
+    StateSnapshot state;
+    std::uint64_t lastSequence = 0;
+    size_t journalBytes = 0;
+    replayState(statePath, state, lastSequence, journalBytes);
+
+    if (journalBytes > 0) {
+        file = std::fopen(journalFilename.c_str(), "r+b");
+        if (file != nullptr && (!truncateFile(file, journalBytes) || std::fseek(file, 0, SEEK_END) != 0)) {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+    else {
+        file = std::fopen(journalFilename.c_str(), "w+b");
+        StateFileHeader header = makeHeader(STATE_JOURNAL_MAGIC);
+        if (file != nullptr && (std::fwrite(&header, sizeof(header), 1, file) != 1 || !syncFile(file))) {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    if (file == nullptr) {
+        throw std::runtime_error("Error: Unable to open state journal " + journalFilename);
+    }
+
+    this->statePath = statePath;
+    nextSequence = lastSequence + 1;
+
+    openSegment(state.baseIndex);
+}
+
+
+
+/**
+ * @brief Opens state.segment for appending and cuts it to the finalized bins of the last record.
+ *
+ * @param finalizedBins - baseIndex of the last record
+ */
+void StateJournal::openSegment(size_t finalizedBins) {
+    std::string segmentFilename = statePath + STATE_SEGMENT_FILE;
+
+    size_t binsInFile = 0;
+    bool validFile = false;
+    if (fileExists(segmentFilename)) {
+        try {
+            MappedFile segment;
+            segment.open(segmentFilename);
+            validFile = hasHeader(segment, STATE_SEGMENT_MAGIC);
+            binsInFile = validFile ? (segment.size() - sizeof(StateFileHeader))/(2*sizeof(double)) : 0;
+        }
+        catch (std::runtime_error const&) {
+            // Empty, it is rewritten below
+        }
+    }
+
+    if (validFile) {
+        segmentBins = (binsInFile < finalizedBins) ? binsInFile : finalizedBins;
+        segmentFile = std::fopen(segmentFilename.c_str(), "r+b");
+        if (segmentFile != nullptr && (!truncateFile(segmentFile, sizeof(StateFileHeader) + segmentBins*2*sizeof(double)) || std::fseek(segmentFile, 0, SEEK_END) != 0)) {
+            std::fclose(segmentFile);
+            segmentFile = nullptr;
+        }
+    }
+    else {
+        segmentBins = 0;
+        segmentFile = std::fopen(segmentFilename.c_str(), "w+b");
+        StateFileHeader header = makeHeader(STATE_SEGMENT_MAGIC);
+        if (segmentFile != nullptr && (std::fwrite(&header, sizeof(header), 1, segmentFile) != 1 || !syncFile(segmentFile))) {
+            std::fclose(segmentFile);
+            segmentFile = nullptr;
+        }
+    }
+
+    if (segmentFile == nullptr) {
+        close();
+        throw std::runtime_error("Error: Unable to open state segment " + segmentFilename);
+    }
+
+    if (segmentBins < finalizedBins) {
+        std::cout << "Warning: " << segmentFilename << " holds " << segmentBins << " of " << finalizedBins << " finalized bins" << std::endl;
+    }
+}
+
+
+
+/**
+ * @brief Stores snapshot. Its finalized bins go to the segment file first. A compact snapshot (which holds the whole window) then replaces
+ * state.snapshot, anything else is appended to the journal. The data is on disk when this returns.
+ *
+ * @param snapshot - Bins [firstBin, totalBins) of the exclusion state
+ */
+void StateJournal::append(StateSnapshot const& snapshot) {
+    appendFinalized(snapshot);
+
+    if (snapshot.compact) {
+        writeSnapshot(snapshot);
+    }
+    else {
+        appendRecord(snapshot);
+    }
+}
+
+/**
+ * @brief Appends the bins that left the window to the segment file and syncs it, so the segment never lags a record that relies on it.
+ *
+ * @param snapshot - Its finalizedBins end at its baseIndex
+ */
+void StateJournal::appendFinalized(StateSnapshot const& snapshot) {
+    size_t count = snapshot.finalizedBins.powers.size();
+    if (count == 0) {
+        return;
+    }
+
+    // A runner that didn't load this state (a new scan in an old state path) starts over, the bins past its first one are dropped
+    size_t firstBin = snapshot.baseIndex - count;
+    if (firstBin < segmentBins) {
+        if (!truncateFile(segmentFile, sizeof(StateFileHeader) + firstBin*2*sizeof(double)) || std::fseek(segmentFile, 0, SEEK_END) != 0) {
+            throw std::runtime_error("Error: Unable to truncate state segment " + statePath + STATE_SEGMENT_FILE);
+        }
+        segmentBins = firstBin;
+    }
+    else if (firstBin > segmentBins) {
+        std::cout << "Warning: " << statePath << STATE_SEGMENT_FILE << " is out of step, bin " << firstBin << " follows bin " 
+                  << segmentBins << std::endl;
+    }
+
+    std::vector<double> pairs(2*count);
+    for (size_t i = 0; i < count; i++) {
+        pairs[2*i] = snapshot.finalizedBins.powers[i];
+        pairs[2*i + 1] = snapshot.finalizedBins.freqAxis[i];
+    }
+
+    if (std::fwrite(pairs.data(), sizeof(double), pairs.size(), segmentFile) != pairs.size() || !syncFile(segmentFile)) {
+        throw std::runtime_error("Error: Unable to append to state segment " + statePath + STATE_SEGMENT_FILE);
+    }
+    segmentBins += count;
+}
+
+void StateJournal::appendRecord(StateSnapshot const& snapshot) {
+    if (!writeRecord(file, snapshot, nextSequence) || !syncFile(file)) {
+        throw std::runtime_error("Error: Unable to append to state journal " + statePath + STATE_JOURNAL_FILE);
+    }
+    nextSequence++;
+}
+
+/**
+ * @brief Writes the whole window to a temporary file, moves it over state.snapshot and empties the journal. A crash at any point leaves
+ * either the old snapshot and journal or the new snapshot, plus journal records that load() skips because the snapshot is newer.
+ *
+ */
+void StateJournal::writeSnapshot(StateSnapshot const& snapshot) {
+    if (snapshot.firstBin != snapshot.baseIndex) {
+        throw std::invalid_argument("Error: A state snapshot has to hold the whole window");
+    }
+
+    std::string snapshotFilename = statePath + STATE_SNAPSHOT_FILE;
+    std::string tempFilename = snapshotFilename + ".tmp";
+
+    std::FILE* tempFile = std::fopen(tempFilename.c_str(), "wb");
+    if (tempFile == nullptr) {
+        throw std::runtime_error("Error: Unable to create state snapshot " + tempFilename);
+    }
+
+    StateFileHeader header = makeHeader(STATE_SNAPSHOT_MAGIC);
+    bool written = std::fwrite(&header, sizeof(header), 1, tempFile) == 1 && writeRecord(tempFile, snapshot, nextSequence) && syncFile(tempFile);
+    std::fclose(tempFile);
+
+    if (!written || !replaceFile(tempFilename, snapshotFilename, true)) {
+        std::remove(tempFilename.c_str());
+        throw std::runtime_error("Error: Unable to write state snapshot " + snapshotFilename);
+    }
+    nextSequence++;
+
+    // Everything in the journal is now in the snapshot
+    if (!truncateFile(file, sizeof(StateFileHeader)) || std::fseek(file, 0, SEEK_END) != 0 || !syncFile(file)) {
+        throw std::runtime_error("Error: Unable to reset state journal " + statePath + STATE_JOURNAL_FILE);
+    }
+}
+
+
+
+void StateJournal::close() {
+    if (file != nullptr) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    if (segmentFile != nullptr) {
+        std::fclose(segmentFile);
+        segmentFile = nullptr;
+    }
+    statePath.clear();
+}
+
+
+
+/**
+ * @brief Whether statePath holds a journal or snapshot to load.
+ *
+ */
+bool StateJournal::exists(std::string const& statePath) {
+    return fileExists(statePath + STATE_SNAPSHOT_FILE) || fileExists(statePath + STATE_JOURNAL_FILE);
+}
+
+
+
+/**
+ * @brief Rebuilds the active window of statePath from the snapshot and the journal records written after it. Both files are memory mapped
+ * and the bins copied straight out of the mapping, the segment file isn't read. Throws if neither file holds a record.
+ *
+ * @param statePath - State directory, with a trailing separator
+ * @return StateSnapshot - The window, bins [baseIndex, totalBins)
+ */
+StateSnapshot StateJournal::load(std::string const& statePath) {
+    StateSnapshot state;
+    state.statePath = statePath;
+
+    std::uint64_t lastSequence;
+    size_t journalBytes;
+    if (!replayState(statePath, state, lastSequence, journalBytes)) {
+        throw std::runtime_error("Error: No exclusion state to load in " + statePath);
+    }
+
+    state.firstBin = state.baseIndex;
+    return state;
+}
+
+
+
+/**
+ * @brief Reads the first bins finalized bins of the exclusion line back from the segment file. Returns fewer if the file holds fewer.
+ *
+ * @param statePath - State directory, with a trailing separator
+ * @param bins - Number of bins, usually the window's baseIndex
+ * @return Spectrum - Exclusion line of bins [0, bins)
+ */
+Spectrum StateJournal::loadFinalized(std::string const& statePath, size_t bins) {
+    Spectrum finalized;
+    finalized.trueCenterFreq = 0;
+
+    std::string segmentFilename = statePath + STATE_SEGMENT_FILE;
+    if (bins == 0 || !fileExists(segmentFilename)) {
+        return finalized;
+    }
+
+    MappedFile segment;
+    segment.open(segmentFilename);
+    if (!hasHeader(segment, STATE_SEGMENT_MAGIC)) {
+        throw std::runtime_error("Error: " + segmentFilename + " is not a version " + std::to_string(STATE_JOURNAL_VERSION) + " state segment");
+    }
+
+    size_t binsInFile = (segment.size() - sizeof(StateFileHeader))/(2*sizeof(double));
+    bins = (bins < binsInFile) ? bins : binsInFile;
+
+    finalized.powers.resize(bins);
+    finalized.freqAxis.resize(bins);
+    const char* pairs = segment.data() + sizeof(StateFileHeader);
+    for (size_t i = 0; i < bins; i++) {
+        std::memcpy(&finalized.powers[i], pairs + (2*i)*sizeof(double), sizeof(double));
+        std::memcpy(&finalized.freqAxis[i], pairs + (2*i + 1)*sizeof(double), sizeof(double));
+    }
+    return finalized;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file stateSaver.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for StateSaver. See include\utils\stateSaver.hpp for class definitions.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+
+// Snapshots submitted but not yet written, the backlog of the disk
+static MetricGauge& saveQueueDepth() {
+    static MetricGauge& depth = metricsRegistry().gauge("save_queue_depth", "State and data snapshots waiting for the disk");
+    return depth;
+}
+
+
+
+StateSaver::StateSaver() : jobsSubmitted(0), jobsWritten(0) {}
+
+StateSaver::~StateSaver() {
+    stop();
+}
+
+
+
+/**
+ * @brief Starts the writer thread. Does nothing if it is already running.
+ *
+ * @param queueCapacity - Snapshots that can wait for the disk before submit() blocks
+ */
+void StateSaver::start(int queueCapacity) {
+    if (isRunning()) {
+        return;
+    }
+
+    jobQueue.reset(new SPSCQueue<SaveJob>(queueCapacity, QUEUE_BLOCK));
+    jobsSubmitted = 0;
+    jobsWritten = 0;
+
+    writerThread = std::thread(&StateSaver::writeJobs, this);
+}
+
+
+
+/**
+ * @brief Queues a snapshot for writing. Writes it on the calling thread if the saver isn't running.
+ *
+ * @param snapshot - Snapshot to write, moved from
+ */
+void StateSaver::submit(StateSnapshot&& snapshot) {
+    if (!isRunning()) {
+        writeState(snapshot);
+        return;
+    }
+
+    SaveJob job;
+    job.state.reset(new StateSnapshot(std::move(snapshot)));
+    submitJob(std::move(job));
+}
+
+void StateSaver::submit(DataSnapshot&& snapshot) {
+    if (!isRunning()) {
+        writeData(snapshot);
+        return;
+    }
+
+    SaveJob job;
+    job.data.reset(new DataSnapshot(std::move(snapshot)));
+    submitJob(std::move(job));
+}
+
+void StateSaver::submitJob(SaveJob&& job) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobsSubmitted++;
+        setMetric(SAVE_QUEUE_DEPTH, (int)(jobsSubmitted - jobsWritten));
+        saveQueueDepth().set((double)(jobsSubmitted - jobsWritten));
+    }
+
+    jobQueue->push(std::move(job));
+}
+
+
+
+/**
+ * @brief Blocks until every snapshot submitted so far is on disk.
+ *
+ */
+void StateSaver::flush() {
+    std::unique_lock<std::mutex> lock(mtx);
+    jobWritten.wait(lock, [this] { return jobsWritten == jobsSubmitted; });
+}
+
+
+
+/**
+ * @brief Writes what is still queued and ends the writer thread. Safe to call when not running.
+ *
+ */
+void StateSaver::stop() {
+    if (!isRunning()) {
+        return;
+    }
+
+    jobQueue->pushFinal(SaveJob());
+    writerThread.join();
+    journal.close();
+
+    QueueStats stats = jobQueue->getStats();
+    if (stats.pushBlockedTime > 0) {
+        std::cout << "Saving waited " << stats.pushBlockedTime << " s on the disk" << std::endl;
+    }
+
+    jobQueue.reset();
+}
+
+
+
+/**
+ * @brief Writer thread. Writes jobs in order until the final (empty) job.
+ *
+ */
+void StateSaver::writeJobs() {
+    while (true) {
+        SaveJob job;
+        jobQueue->waitAndPop(job);
+
+        if (job.state || job.data) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            try {
+                if (job.state) {
+                    writeState(*job.state);
+                }
+                if (job.data) {
+                    writeData(*job.data);
+                }
+            }
+            catch (std::exception const& e) {
+                // Nothing to hand the error back to, keep writing the later snapshots
+                std::cout << e.what() << std::endl;
+            }
+            addTime(TIMER_SAVE, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            std::lock_guard<std::mutex> lock(mtx);
+            jobsWritten++;
+            saveQueueDepth().set((double)(jobsSubmitted - jobsWritten));
+            jobWritten.notify_all();
+        }
+
+        if (jobQueue->isInputComplete() && jobQueue->empty()) {
+            break;
+        }
+    }
+}
+
+
+
+/**
+ * @brief Journals the changed bins of the exclusion line, coeffSumA and coeffSumB and writes scanInfo.json to the state path.
+ *
+ * @param snapshot - State to write
+ */
+void StateSaver::writeState(StateSnapshot const& snapshot) {
+    if (!journal.isOpen() || journal.getStatePath() != snapshot.statePath) {
+        journal.open(snapshot.statePath);
+    }
+    journal.append(snapshot);
+
+    // Save the freqRes, statIndex, and cutoffIndex to a json file
+    json scanInfo;
+    scanInfo["freqRes"] = formatWithPrecision(snapshot.freqRes, snapshot.precision);
+    scanInfo["startIndex"] = snapshot.startIndex;
+    scanInfo["cutoffIndex"] = snapshot.cutoffIndex;
+    scanInfo["previousCenterFreq"] = formatWithPrecision(snapshot.trueCenterFreq, snapshot.precision);
+
+    std::ofstream jsonFile(snapshot.statePath + snapshot.prefix + "scanInfo.json");
+    jsonFile << scanInfo;
+}
+
+
+
+/**
+ * @brief Writes the frequency axis, outliers, baseline, running average and exclusion line CSVs to the save path, plus the per step exclusion
+ * line and scan info files. The exclusion line is written whole, with its finalized bins read back from the state journal's segment file.
+ *
+ * @param snapshot - Step results to write. Its running average is moved out
+ */
+void StateSaver::writeData(DataSnapshot& snapshot) {
+    // Filtered both ways over the whole spectrum, which is why the scan thread leaves it to this one
+    DataProcessor baselineProcessor;
+    baselineProcessor.chebyshevFilter.setParams(snapshot.baselineFilter);
+    baselineProcessor.runningAverage = std::move(snapshot.runningAverage);
+    baselineProcessor.updateBaseline();
+
+    std::vector<double> const& runningAverage = baselineProcessor.runningAverage;
+
+    Spectrum exclusionLine = StateJournal::loadFinalized(snapshot.statePath, snapshot.segmentBins);
+    exclusionLine.powers.insert(exclusionLine.powers.end(), snapshot.exclusionLine.powers.begin(), snapshot.exclusionLine.powers.end());
+    exclusionLine.freqAxis.insert(exclusionLine.freqAxis.end(), snapshot.exclusionLine.freqAxis.begin(), snapshot.exclusionLine.freqAxis.end());
+
+    std::vector<int> outliers = findOutliers(runningAverage, 50, 4);
+
+    std::vector<double> freq(snapshot.samplesPerBuffer);
+    for (std::size_t i = 0; i < freq.size(); ++i) {
+        freq[i] = (static_cast<double>(i)-static_cast<double>(snapshot.samplesPerBuffer)/2)
+                    *snapshot.sampleRate/snapshot.samplesPerBuffer/1e6;
+    }
+
+    saveVector(freq, snapshot.savePath + "freq.csv");
+    saveVector(outliers, snapshot.savePath + "outliers.csv");
+
+    saveVector(baselineProcessor.currentBaseline, snapshot.savePath + "baseline.csv");
+    saveVector(runningAverage, snapshot.savePath + "runningAverage.csv");
+
+    saveSpectrum(exclusionLine, snapshot.savePath + "exclusionLine.csv");
+
+    std::string exclusionLineFilename = snapshot.savePath + "data/exclusionLine_";
+    std::string scanInfoFilename = snapshot.savePath + "metrics/scanInfo_";
+
+    if (snapshot.decisionMaking){
+        exclusionLineFilename += "dynamic_";
+        scanInfoFilename += "dynamic_";
+    }
+
+    exclusionLineFilename += snapshot.timestamp + ".csv";
+    scanInfoFilename += snapshot.timestamp + ".csv";
+
+    saveSpectrum(exclusionLine, exclusionLineFilename);
+    saveVector(snapshot.acquiredSpectra, scanInfoFilename);
+}
@@ -11,31 +11,219 @@
 
 #include "decs.hpp"
 
-static double timers[NUM_TIMERS];
-static double times[NUM_TIMERS] = {0};
+// Per call timing. Each thread that times a stage adds to its own block, so the stages never share a counter and a stage can run on
+// several threads, or in two overlapping steps, at once. Reports sum the blocks
+struct TimerAccumulator {
+    std::atomic<std::uint64_t> calls;
+    std::atomic<std::uint64_t> items;
+    std::atomic<std::uint64_t> totalTime;      // ns
+    std::atomic<std::uint64_t> maxTime;        // ns
+    std::atomic<std::uint64_t> histogram[TIMER_HISTOGRAM_BUCKETS];
+
+    void clear() {
+        calls.store(0, std::memory_order_relaxed);
+        items.store(0, std::memory_order_relaxed);
+        totalTime.store(0, std::memory_order_relaxed);
+        maxTime.store(0, std::memory_order_relaxed);
+        for (int n = 0; n < TIMER_HISTOGRAM_BUCKETS; n++) {
+            histogram[n].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+struct ThreadTimers {
+    ThreadTimers() : inUse(false) {
+        for (int n = 0; n < NUM_TIMERS; n++) {
+            timers[n].clear();
+            starts[n] = 0;
+        }
+    }
+
+    TimerAccumulator timers[NUM_TIMERS];
+    std::int64_t starts[NUM_TIMERS];    // startTimer() times of the owning thread
+    bool inUse;                         // Owned by a live thread, guarded by timerBlocksMutex
+};
+
+static std::mutex timerBlocksMutex;
+static std::vector<std::unique_ptr<ThreadTimers>> timerBlocks;
+
+// Claims a block on the first timed call of a thread and hands it back when the thread exits. The counts stay in the block, so stages run by
+// threads that have since exited still show up, and the next new thread adds to them rather than growing the list
+struct ThreadTimersHandle {
+    ThreadTimersHandle() : block(nullptr) {
+        std::lock_guard<std::mutex> lock(timerBlocksMutex);
+
+        for (std::unique_ptr<ThreadTimers>& candidate : timerBlocks) {
+            if (!candidate->inUse) {
+                block = candidate.get();
+                break;
+            }
+        }
+        if (block == nullptr) {
+            timerBlocks.emplace_back(new ThreadTimers());
+            block = timerBlocks.back().get();
+        }
+        block->inUse = true;
+    }
+
+    ~ThreadTimersHandle() {
+        std::lock_guard<std::mutex> lock(timerBlocksMutex);
+        block->inUse = false;
+    }
+
+    ThreadTimers* block;
+};
+
+static ThreadTimers& threadTimers() {
+    thread_local ThreadTimersHandle handle;
+    return *handle.block;
+}
+
+static std::int64_t timerClock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 
 static std::vector<int> metrics[NUM_METRICS];
 
+static QueueStats queueStats[NUM_QUEUES];
+static const char* queueNames[NUM_QUEUES] = {"raw", "fft", "magnitude", "processing", "decision"};
+
+static const char* timerNames[NUM_TIMERS] = {"acquisition", "fft", "magnitude", "averaging", "processing", "decision", "save", "step"};
+
+
+
+// Histogram bucket of a call of ns nanoseconds, see TIMER_HISTOGRAM_BUCKETS
+static int timerBucket(std::uint64_t ns) {
+    if (ns < 16) {
+        return (int)ns;
+    }
+
+    int exponent = 4;
+    while (exponent < 63 && (ns >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+
+    int bucket = 16 + (exponent - 4)*8 + (int)((ns >> (exponent - 3)) & 7);
+    return (bucket < TIMER_HISTOGRAM_BUCKETS) ? bucket : TIMER_HISTOGRAM_BUCKETS - 1;
+}
+
+// Middle of a histogram bucket in ns
+static double bucketMidpoint(int bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+
+    int exponent = 4 + (bucket - 16)/8;
+    int subBucket = (bucket - 16)%8;
+    return std::ldexp(1.0, exponent) + (subBucket + 0.5)*std::ldexp(1.0, exponent - 3);
+}
+
+// Adds one call of duration ns, handling items, to the calling thread's share of the timer
+static void recordCall(int timerCode, std::int64_t duration, std::uint64_t items) {
+    std::uint64_t ns = (duration > 0) ? (std::uint64_t)duration : 0;
+    TimerAccumulator& timer = threadTimers().timers[timerCode];
+
+    timer.calls.fetch_add(1, std::memory_order_relaxed);
+    timer.items.fetch_add(items, std::memory_order_relaxed);
+    timer.totalTime.fetch_add(ns, std::memory_order_relaxed);
+    timer.histogram[timerBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    // Only the owning thread raises the max
+    if (ns > timer.maxTime.load(std::memory_order_relaxed)) {
+        timer.maxTime.store(ns, std::memory_order_relaxed);
+    }
+}
+
+
+
+// Overwrites the total of a timer. The calls and histogram are cleared, val is not counted as a call
 void setTime(int timerCode, double val) {
-    times[timerCode] = val;
+    ThreadTimers& own = threadTimers();
+
+    std::lock_guard<std::mutex> lock(timerBlocksMutex);
+    for (std::unique_ptr<ThreadTimers>& block : timerBlocks) {
+        block->timers[timerCode].clear();
+    }
+    own.timers[timerCode].totalTime.store((std::uint64_t)(val*1e9), std::memory_order_relaxed);
 }
 
 double getTime(int timerCode) { 
-    return times[timerCode]; 
+    return getTimerStats(timerCode).total; 
 }
 
+// Start times are per thread, so the same timer can be running on several threads
 void startTimer(int timerCode) {
-    timers[timerCode] = GetTickCount();
+    threadTimers().starts[timerCode] = timerClock();
 }
 
-void stopTimer(int timerCode) {
-    times[timerCode] += (GetTickCount() - timers[timerCode])/1000;
+// Ends the call started by this thread's last startTimer(timerCode). items is what the call handled, for the stage throughput
+void stopTimer(int timerCode, std::uint64_t items) {
+    ThreadTimers& own = threadTimers();
+    recordCall(timerCode, timerClock() - own.starts[timerCode], items);
 }
 
+// For stages that time themselves, adds one call of the given length
+void addTime(int timerCode, double seconds, std::uint64_t items) {
+    recordCall(timerCode, (std::int64_t)(seconds*1e9), items);
+}
+
+// Sums every thread's share of a timer. Percentiles come from the histogram, so are the middle of the bucket the call fell in
+TimerStats getTimerStats(int timerCode) {
+    TimerStats stats;
+    std::uint64_t totalTime = 0;
+    std::uint64_t maxTime = 0;
+    std::vector<std::uint64_t> histogram(TIMER_HISTOGRAM_BUCKETS, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(timerBlocksMutex);
+        for (std::unique_ptr<ThreadTimers> const& block : timerBlocks) {
+            TimerAccumulator const& timer = block->timers[timerCode];
+
+            stats.calls += timer.calls.load(std::memory_order_relaxed);
+            stats.items += timer.items.load(std::memory_order_relaxed);
+            totalTime += timer.totalTime.load(std::memory_order_relaxed);
+
+            std::uint64_t blockMax = timer.maxTime.load(std::memory_order_relaxed);
+            maxTime = (blockMax > maxTime) ? blockMax : maxTime;
+
+            for (int n = 0; n < TIMER_HISTOGRAM_BUCKETS; n++) {
+                histogram[n] += timer.histogram[n].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    stats.total = totalTime*1e-9;
+    stats.maxTime = maxTime*1e-9;
+    stats.throughput = (totalTime > 0) ? stats.items/stats.total : 0;
+
+    // The call at each fraction of the sorted calls, capped at the longest call
+    auto percentile = [&](double fraction) {
+        std::uint64_t rank = (std::uint64_t)std::ceil(fraction*stats.calls);
+        std::uint64_t seen = 0;
+        for (int n = 0; n < TIMER_HISTOGRAM_BUCKETS; n++) {
+            seen += histogram[n];
+            if (seen >= rank && seen > 0) {
+                double midpoint = bucketMidpoint(n);
+                return ((midpoint < maxTime) ? midpoint : maxTime)*1e-9;
+            }
+        }
+        return 0.0;
+    };
+    stats.p50 = percentile(0.5);
+    stats.p99 = percentile(0.99);
+
+    return stats;
+}
+
+// Clears every timer. Not meant to run while stages are being timed, a call in flight may land on either side of the reset
 void resetTimers()
 {
-    for (int n = 0; n < NUM_TIMERS; n++) {
-        times[n] = 0.;
+    std::lock_guard<std::mutex> lock(timerBlocksMutex);
+    for (std::unique_ptr<ThreadTimers>& block : timerBlocks) {
+        for (int n = 0; n < NUM_TIMERS; n++) {
+            block->timers[n].clear();
+        }
     }
 }
 
@@ -44,14 +232,23 @@ void resetMetrics()
     for (int n = 0; n < NUM_METRICS; n++) {
         metrics[n].clear();
     }
+
+    for (int n = 0; n < NUM_QUEUES; n++) {
+        queueStats[n] = QueueStats();
+    }
 }
 
 
+// Overlapping steps (ScanRunner::runSteps) can set metrics from two pipelines at once
+static std::mutex metricMutex;
+
 void setMetric(int metricCode, int val) {
+    std::lock_guard<std::mutex> lock(metricMutex);
     metrics[metricCode].push_back(val);
 }
 
 void updateMetric(int metricCode, int val) {
+    std::lock_guard<std::mutex> lock(metricMutex);
     metrics[metricCode].back() = val;
 }
 
@@ -59,18 +256,42 @@ std::vector<int> getMetric(int metricCode) {
     return metrics[metricCode];
 }
 
+// Fold one acquisition's queue counters into the running totals. Max depth is the high-watermark over all acquisitions
+void recordQueueStats(int queueCode, QueueStats stats) {
+    QueueStats& total = queueStats[queueCode];
+
+    total.capacity = stats.capacity;
+    total.pushed += stats.pushed;
+    total.maxDepth = (stats.maxDepth > total.maxDepth) ? stats.maxDepth : total.maxDepth;
+    total.overflows += stats.overflows;
+    total.drops += stats.drops;
+    total.pushBlockedTime += stats.pushBlockedTime;
+    total.popWaitTime += stats.popWaitTime;
+
+    // Per step, so the registry lookups are cheap enough
+    std::string prefix = std::string("queue_") + queueNames[queueCode];
+    metricsRegistry().gauge(prefix + "_max_depth", "High-watermark of the queue in the last step").set((double)stats.maxDepth);
+    metricsRegistry().gauge(prefix + "_capacity", "Capacity of the queue").set((double)stats.capacity);
+    metricsRegistry().counter(prefix + "_overflows_total", "Pushes that found the queue full").add(stats.overflows);
+    metricsRegistry().counter(prefix + "_drops_total", "Elements the queue discarded").add(stats.drops);
+}
+
+QueueStats getQueueStats(int queueCode) {
+    return queueStats[queueCode];
+}
+
 // Report a running average of timing data
 void reportPerformance()
 {
     fprintf(stdout, "\n********** ABSOLUTE PERFORMANCE **********\n");
 
-    fprintf(stdout, "   DATA ACQUISITION:    %8.4g s\n", times[TIMER_ACQUISITION]);
-    fprintf(stdout, "   FOURIER TRANSFORM:   %8.4g s\n", times[TIMER_FFT]);
-    fprintf(stdout, "   FFT MAGNITUDE:       %8.4g s\n", times[TIMER_MAG]);
-    fprintf(stdout, "   AVERAGING:           %8.4g s\n", times[TIMER_AVERAGE]);
-    fprintf(stdout, "   PROCESSING:          %8.4g s\n", times[TIMER_PROCESS]);
-    fprintf(stdout, "   DECISION MAKING:     %8.4g s\n", times[TIMER_DECISION]);
-    fprintf(stdout, "   DATA SAVING:         %8.4g s\n", times[TIMER_SAVE]);
+    // Totals are summed over threads, so stages that run on several workers can exceed the wall time
+    fprintf(stdout, "   %-12s %10s %9s %10s %10s %10s %12s\n", "STAGE", "TOTAL (s)", "CALLS", "P50 (ms)", "P99 (ms)", "MAX (ms)", "ITEMS/s");
+    for (int n = 0; n < NUM_TIMERS; n++) {
+        TimerStats stats = getTimerStats(n);
+        fprintf(stdout, "   %-12s %10.4g %9llu %10.4g %10.4g %10.4g %12.4g\n", timerNames[n], stats.total, (unsigned long long)stats.calls,
+                stats.p50*1e3, stats.p99*1e3, stats.maxTime*1e3, stats.throughput);
+    }
 
     fprintf(stdout, "*********************************\n\n");
 
@@ -96,10 +317,29 @@ void reportPerformance()
     fprintf(stdout, "\n********** PER SPECTRUM PERFORMANCE **********\n");
 
     fprintf(stdout, "   ACQUIRED SPECTRA:                     %d \n", totalAcquiredSpectra);
-    fprintf(stdout, "   AVERAGE ACQUISITION TIME:             %8.4g \n", times[TIMER_ACQUISITION]/(double)totalAcquiredSpectra);
+    fprintf(stdout, "   AVERAGE ACQUISITION TIME:             %8.4g \n", getTime(TIMER_ACQUISITION)/(double)totalAcquiredSpectra);
     fprintf(stdout, "   AVERAGE DECISION ENFORCEMENT DELAY:   %8.4g \n", averageDecisionEnforcementDelay);
 
+    int maxSaveQueueDepth = 0;
+    for (int depth : metrics[SAVE_QUEUE_DEPTH]) {
+        maxSaveQueueDepth = (depth > maxSaveQueueDepth) ? depth : maxSaveQueueDepth;
+    }
+    fprintf(stdout, "   MAX SAVE QUEUE DEPTH:                 %d \n", maxSaveQueueDepth);
+
     fprintf(stdout, "*********************************\n\n");
+
+
+    fprintf(stdout, "\n********** PIPELINE QUEUES **********\n");
+
+    fprintf(stdout, "   %-12s %8s %9s %10s %8s %12s %12s\n", "QUEUE", "CAPACITY", "MAX DEPTH", "OVERFLOWS", "DROPS", "BLOCKED (s)", "STARVED (s)");
+    for (int n = 0; n < NUM_QUEUES; n++) {
+        fprintf(stdout, "   %-12s %8zu %9zu %10zu %8zu %12.4g %12.4g\n", queueNames[n], queueStats[n].capacity, queueStats[n].maxDepth, 
+                queueStats[n].overflows, queueStats[n].drops, queueStats[n].pushBlockedTime, queueStats[n].popWaitTime);
+    }
+
+    fprintf(stdout, "*********************************\n\n");
+
+    reportLatency();
 }
 
 
@@ -108,18 +348,28 @@ void reportPerformance()
 json performanceToJson() {
     json jsonPerf;
 
-    // Serialize timing data
+    // Serialize timing data. "timers" keeps the plain totals, "timerStats" adds the per call distribution and throughput
     json timingData;
-    
-    timingData["acquisition"] = times[TIMER_ACQUISITION];
-    timingData["fft"] = times[TIMER_FFT];
-    timingData["magnitude"] = times[TIMER_MAG];
-    timingData["averaging"] = times[TIMER_AVERAGE];
-    timingData["processing"] = times[TIMER_PROCESS];
-    timingData["decision"] = times[TIMER_DECISION];
-    timingData["save"] = times[TIMER_SAVE];
+    json timerStats;
+
+    for (int n = 0; n < NUM_TIMERS; n++) {
+        TimerStats stats = getTimerStats(n);
+        timingData[timerNames[n]] = stats.total;
+
+        json timer;
+        timer["total"] = stats.total;
+        timer["calls"] = stats.calls;
+        timer["items"] = stats.items;
+        timer["p50"] = stats.p50;
+        timer["p99"] = stats.p99;
+        timer["max"] = stats.maxTime;
+        timer["throughput"] = stats.throughput;
+
+        timerStats[timerNames[n]] = timer;
+    }
 
     jsonPerf["timers"] = timingData;
+    jsonPerf["timerStats"] = timerStats;
 
 
     // Serialize metric data
@@ -128,9 +378,35 @@ json performanceToJson() {
     metricData["acquiredSpectra"] = metrics[ACQUIRED_SPECTRA];
     metricData["spectraAtDecision"] = metrics[SPECTRA_AT_DECISION];
     metricData["spectrumAverageSize"] = metrics[SPECTRUM_AVERAGE_SIZE];
+    metricData["saveQueueDepth"] = metrics[SAVE_QUEUE_DEPTH];
 
     jsonPerf["metrics"] = metricData;
 
 
+    // Serialize queue data
+    json queueData;
+
+    for (int n = 0; n < NUM_QUEUES; n++) {
+        json queue;
+        queue["capacity"] = queueStats[n].capacity;
+        queue["pushed"] = queueStats[n].pushed;
+        queue["maxDepth"] = queueStats[n].maxDepth;
+        queue["overflows"] = queueStats[n].overflows;
+        queue["drops"] = queueStats[n].drops;
+        queue["pushBlockedTime"] = queueStats[n].pushBlockedTime;
+        queue["popWaitTime"] = queueStats[n].popWaitTime;
+
+        queueData[queueNames[n]] = queue;
+    }
+
+    jsonPerf["queues"] = queueData;
+
+
+    // Measured acquisition to decision latency, when the pipeline is traced
+    if (traceEnabled()) {
+        jsonPerf["latency"] = latencyToJson();
+    }
+
+
     return jsonPerf;
 }
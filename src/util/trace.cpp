@@ -0,0 +1,371 @@
+/**
+ * @file trace.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions for TraceBuffer, and the pipeline trace built on it: recording, the acquisition to decision latency histograms and
+ *        the Chrome trace export. See include\utils\trace.hpp for class definitions.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+static_assert(sizeof(TraceEvent) == 40, "TraceEvent should stay 40 bytes, the trace capacity is sized from it");
+
+static TraceBuffer traceBuffer;
+static std::atomic<bool> tracing(false);
+
+static const char* traceStageNames[NUM_TRACE_STAGES] = {"acquisition", "fft", "magnitude", "averaging", "processing", "decision"};
+
+
+TraceBuffer::TraceBuffer() : capacity(0), nextSlot(0), droppedEvents(0) {}
+
+
+
+/**
+ * @brief Empties the buffer and makes room for capacity events. The slots are allocated here, so record() never allocates.
+ *
+ * @param capacity - Events the buffer can hold, 0 to free it
+ */
+void TraceBuffer::reset(size_t capacity) {
+    if (capacity != this->capacity) {
+        slots.reset(capacity > 0 ? new TraceEvent[capacity] : nullptr);
+        ready.reset(capacity > 0 ? new std::atomic<bool>[capacity] : nullptr);
+        this->capacity = capacity;
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        ready[i].store(false, std::memory_order_relaxed);
+    }
+    nextSlot.store(0);
+    droppedEvents.store(0);
+}
+
+
+
+/**
+ * @brief Adds one event. Safe to call from any number of threads at once, never blocks.
+ *
+ * @param event - Event to copy into the buffer
+ */
+void TraceBuffer::record(TraceEvent const& event) {
+    size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= capacity) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    slots[slot] = event;
+    ready[slot].store(true, std::memory_order_release);
+}
+
+
+
+/**
+ * @brief Copy of the recorded events in the order their slots were claimed, which is time order for the events of any one thread. Events
+ * whose slot was claimed but not yet written are left out.
+ *
+ * @return std::vector<TraceEvent> - Recorded events
+ */
+std::vector<TraceEvent> TraceBuffer::events() const {
+    size_t claimed = nextSlot.load(std::memory_order_relaxed);
+    size_t count = (claimed < capacity) ? claimed : capacity;
+
+    std::vector<TraceEvent> copy;
+    copy.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (ready[i].load(std::memory_order_acquire)) {
+            copy.push_back(slots[i]);
+        }
+    }
+    return copy;
+}
+
+
+
+/**
+ * @brief Monotonic clock of the trace in nanoseconds. Only differences are meaningful.
+ *
+ */
+std::int64_t traceClock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+/**
+ * @brief Clears the trace and starts recording into a buffer of capacity events, or stops tracing if capacity is 0. Must not be called
+ * while a pipeline is running.
+ *
+ * @param capacity - Events to make room for
+ */
+void startTrace(size_t capacity) {
+    tracing = false;
+    traceBuffer.reset(capacity);
+    tracing = (capacity > 0);
+}
+
+
+
+bool traceEnabled() {
+    return tracing.load(std::memory_order_relaxed);
+}
+
+
+
+/**
+ * @brief Records that a stage reached point kind with the buffers of tag. Does nothing unless the trace was started.
+ *
+ * @param tag - Buffers the block or spectrum was made from
+ * @param stage - TRACE_ACQUISITION ... TRACE_DECISION
+ * @param kind - TRACE_ENQUEUE, TRACE_DEQUEUE or TRACE_FINISH
+ */
+void traceEvent(TraceTag const& tag, int stage, int kind) {
+    if (!tracing.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    static std::atomic<int> threadsSeen(0);
+    thread_local int threadNumber = threadsSeen.fetch_add(1);
+
+    TraceEvent event;
+    event.time = traceClock();
+    event.acquiredTime = tag.acquiredTime;
+    event.firstBuffer = tag.firstBuffer;
+    event.bufferCount = tag.bufferCount;
+    event.step = tag.step;
+    event.stage = (std::uint8_t)stage;
+    event.kind = (std::uint8_t)kind;
+    event.thread = (std::uint16_t)threadNumber;
+
+    traceBuffer.record(event);
+}
+
+
+
+/**
+ * @brief Tag of buffer index of a block. The board hands buffers over at a fixed rate, so its time is interpolated between the first and 
+ * last buffer of the block.
+ *
+ * @param tag - Tag of the whole block
+ * @param index - Buffer within the block, below tag.bufferCount
+ */
+TraceTag bufferTag(TraceTag const& tag, int index) {
+    TraceTag buffer = tag;
+    buffer.firstBuffer = tag.firstBuffer + index;
+    buffer.bufferCount = 1;
+    if (tag.bufferCount > 1) {
+        buffer.acquiredTime = tag.firstAcquiredTime + (tag.acquiredTime - tag.firstAcquiredTime)*index/(tag.bufferCount - 1);
+    }
+    buffer.firstAcquiredTime = buffer.acquiredTime;
+    return buffer;
+}
+
+
+
+/**
+ * @brief Tag covering the buffers from the start of first to the end of last, for a spectrum averaged from several blocks.
+ *
+ */
+TraceTag mergeTags(TraceTag const& first, TraceTag const& last) {
+    TraceTag merged = first;
+    merged.bufferCount = (std::uint32_t)(last.firstBuffer + last.bufferCount - first.firstBuffer);
+    merged.acquiredTime = last.acquiredTime;
+    return merged;
+}
+
+
+
+std::vector<TraceEvent> getTraceEvents() {
+    return traceBuffer.events();
+}
+
+
+
+/**
+ * @brief Acquisition to decision latency of every traced spectrum, in seconds, grouped by step: the time from the board handing over the
+ * last buffer of a spectrum to the decision thread finishing with it.
+ *
+ */
+static std::map<int, std::vector<double>> latenciesByStep() {
+    std::map<int, std::vector<double>> latencies;
+
+    for (TraceEvent const& event : traceBuffer.events()) {
+        if (event.stage == TRACE_DECISION && event.kind == TRACE_FINISH && event.acquiredTime != 0) {
+            latencies[event.step].push_back((event.time - event.acquiredTime)*1e-9);
+        }
+    }
+
+    for (auto& step : latencies) {
+        std::sort(step.second.begin(), step.second.end());
+    }
+    return latencies;
+}
+
+
+
+static double percentile(std::vector<double> const& sorted, double fraction) {
+    size_t index = (size_t)(fraction*(sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+
+
+static std::vector<int> latencyHistogram(std::vector<double> const& latencies) {
+    std::vector<int> counts(TRACE_LATENCY_BUCKETS, 0);
+
+    for (double latency : latencies) {
+        double microseconds = latency*1e6;
+        int bucket = 0;
+        while (bucket < TRACE_LATENCY_BUCKETS - 1 && microseconds >= std::ldexp(1.0, bucket)) {
+            bucket++;
+        }
+        counts[bucket]++;
+    }
+    return counts;
+}
+
+
+
+/**
+ * @brief Prints the acquisition to decision latency of the latest traced step and of the whole trace. Does nothing unless tracing.
+ *
+ */
+void reportLatency() {
+    if (!traceEnabled()) {
+        return;
+    }
+
+    std::map<int, std::vector<double>> latencies = latenciesByStep();
+
+    std::vector<double> all;
+    for (auto const& step : latencies) {
+        all.insert(all.end(), step.second.begin(), step.second.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    fprintf(stdout, "\n********** ACQUISITION TO DECISION LATENCY **********\n");
+
+    fprintf(stdout, "   %-12s %8s %10s %10s %10s %10s\n", "STEP", "SPECTRA", "P50 (ms)", "P90 (ms)", "P99 (ms)", "MAX (ms)");
+    if (!latencies.empty()) {
+        std::vector<double> const& last = latencies.rbegin()->second;
+        fprintf(stdout, "   %-12d %8zu %10.4g %10.4g %10.4g %10.4g\n", latencies.rbegin()->first, last.size(),
+                percentile(last, 0.5)*1e3, percentile(last, 0.9)*1e3, percentile(last, 0.99)*1e3, last.back()*1e3);
+    }
+    if (!all.empty()) {
+        fprintf(stdout, "   %-12s %8zu %10.4g %10.4g %10.4g %10.4g\n", "ALL", all.size(),
+                percentile(all, 0.5)*1e3, percentile(all, 0.9)*1e3, percentile(all, 0.99)*1e3, all.back()*1e3);
+    }
+    if (traceBuffer.dropped() > 0) {
+        fprintf(stdout, "   Trace buffer full, %zu events dropped\n", traceBuffer.dropped());
+    }
+
+    fprintf(stdout, "*********************************\n\n");
+}
+
+
+
+/**
+ * @brief Acquisition to decision latency histograms per step. Each step has its spectrum count, percentiles in seconds and counts per
+ * TRACE_LATENCY_BUCKETS bucket.
+ *
+ */
+json latencyToJson() {
+    json steps = json::array();
+
+    for (auto const& step : latenciesByStep()) {
+        json stepData;
+        stepData["step"] = step.first;
+        stepData["spectra"] = step.second.size();
+        stepData["p50"] = percentile(step.second, 0.5);
+        stepData["p90"] = percentile(step.second, 0.9);
+        stepData["p99"] = percentile(step.second, 0.99);
+        stepData["max"] = step.second.back();
+        stepData["histogram"] = latencyHistogram(step.second);
+
+        steps.push_back(stepData);
+    }
+
+    json latency;
+    latency["steps"] = steps;
+    latency["droppedEvents"] = traceBuffer.dropped();
+
+    return latency;
+}
+
+
+
+/**
+ * @brief Writes the trace in the Chrome trace event format (chrome://tracing or ui.perfetto.dev). Each stage's work on a block or spectrum
+ * is a span on the thread that did it, from the dequeue (or the end of its previous item) to the finish. Acquired buffers and queue pushes
+ * are instant events.
+ *
+ * @param filename - JSON file to write
+ */
+void saveChromeTrace(std::string const& filename) {
+    std::vector<TraceEvent> events = traceBuffer.events();
+
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        std::cout << "Error: Unable to write trace " << filename << std::endl;
+        return;
+    }
+
+    std::int64_t origin = events.empty() ? 0 : events.front().time;
+    for (TraceEvent const& event : events) {
+        origin = (event.time < origin) ? event.time : origin;
+    }
+
+    // Start of the current span on each thread: its last dequeue or finish
+    std::map<int, std::int64_t> spanStart;
+    std::map<int, int> threadStage;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    for (TraceEvent const& event : events) {
+        double timestamp = (event.time - origin)*1e-3;
+        const char* stageName = traceStageNames[event.stage < NUM_TRACE_STAGES ? event.stage : 0];
+
+        if (threadStage.find(event.thread) == threadStage.end()) {
+            threadStage[event.thread] = event.stage;
+            std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                         first ? "" : ",\n", (int)event.thread, stageName, (int)event.thread);
+            first = false;
+        }
+
+        if (event.kind == TRACE_DEQUEUE) {
+            spanStart[event.thread] = event.time;
+            std::fprintf(file, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s dequeue\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"step\":%d,\"firstBuffer\":%llu,\"buffers\":%u}}",
+                         stageName, (int)event.thread, timestamp, event.step, (unsigned long long)event.firstBuffer, event.bufferCount);
+        }
+        else if (event.kind == TRACE_ENQUEUE) {
+            std::fprintf(file, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s enqueue\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"step\":%d,\"firstBuffer\":%llu,\"buffers\":%u}}",
+                         stageName, (int)event.thread, timestamp, event.step, (unsigned long long)event.firstBuffer, event.bufferCount);
+        }
+        else if (event.stage == TRACE_ACQUISITION) {
+            // The acquisition tags its block as it fills, the buffer just acquired is the last of the range
+            std::fprintf(file, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"buffer acquired\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"step\":%d,\"buffer\":%llu}}",
+                         (int)event.thread, timestamp, event.step, (unsigned long long)(event.firstBuffer + event.bufferCount - 1));
+        }
+        else {
+            std::int64_t start = (spanStart.find(event.thread) != spanStart.end()) ? spanStart[event.thread] : event.time;
+            spanStart[event.thread] = event.time;
+
+            std::fprintf(file, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                         "\"args\":{\"step\":%d,\"firstBuffer\":%llu,\"buffers\":%u,\"latencyMs\":%.4f}}",
+                         stageName, (int)event.thread, (start - origin)*1e-3, (event.time - start)*1e-3, event.step,
+                         (unsigned long long)event.firstBuffer, event.bufferCount, (event.time - event.acquiredTime)*1e-6);
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+
+    std::cout << "Wrote " << events.size() << " trace events to " << filename << std::endl;
+}
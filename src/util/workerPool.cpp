@@ -0,0 +1,163 @@
+/**
+ * @file workerPool.cpp
+ * @author your name (you@domain.com)
+ * @brief Method definitions and documentation for PipelineWorker and WorkerPool. See include\utils\workerPool.hpp for class definitions.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "decs.hpp"
+
+
+PipelineWorker::PipelineWorker() : busy(false), shutdown(false) {
+    thread = std::thread(&PipelineWorker::workerLoop, this);
+}
+
+PipelineWorker::~PipelineWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        shutdown = true;
+    }
+    taskPosted.notify_one();
+    thread.join();
+}
+
+
+
+/**
+ * @brief Hands the worker its next task. Waits for the current task first if there is one.
+ *
+ * @param task - Task to run
+ * @param settings - Affinity and priority to run it with
+ */
+void PipelineWorker::run(std::function<void()> task, WorkerSettings const& settings) {
+    std::unique_lock<std::mutex> lock(mtx);
+    taskDone.wait(lock, [this] { return !busy; });
+
+    this->task = std::move(task);
+    pendingSettings = settings;
+    busy = true;
+
+    lock.unlock();
+    taskPosted.notify_one();
+}
+
+
+
+/**
+ * @brief Blocks until the worker has finished its task. Returns immediately if it is idle.
+ *
+ */
+void PipelineWorker::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    taskDone.wait(lock, [this] { return !busy; });
+}
+
+bool PipelineWorker::isBusy() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return busy;
+}
+
+
+
+/**
+ * @brief Worker thread. Sleeps until a task is posted, applies the task's settings if they differ from the last ones and runs it.
+ *
+ */
+void PipelineWorker::workerLoop() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        taskPosted.wait(lock, [this] { return busy || shutdown; });
+        if (!busy) {
+            break;
+        }
+
+        std::function<void()> current = std::move(task);
+        WorkerSettings settings = pendingSettings;
+        lock.unlock();
+
+        if (settings.affinityMask != appliedSettings.affinityMask || settings.priority != appliedSettings.priority) {
+            applySettings(settings);
+            appliedSettings = settings;
+        }
+        current();
+
+        // Drop the task's bound arguments before reporting done, they may reference the caller's queues
+        current = nullptr;
+
+        lock.lock();
+        busy = false;
+        taskDone.notify_all();
+    }
+}
+
+
+
+/**
+ * @brief Pins the calling (worker) thread to settings.affinityMask and sets its priority. A mask of 0 goes back to every CPU of the process.
+ * Priorities are only applied on Windows. Failures are reported and the task runs anyway.
+ *
+ * @param settings - Settings to apply
+ */
+void PipelineWorker::applySettings(WorkerSettings const& settings) {
+    if (!setThreadAffinity(settings.affinityMask)) {
+        std::cout << "Warning: Unable to set worker affinity mask 0x" << std::hex << settings.affinityMask << std::dec << std::endl;
+    }
+    if (!setThreadPriority(settings.priority)) {
+        std::cout << "Warning: Unable to set worker priority " << settings.priority << std::endl;
+    }
+}
+
+
+
+/**
+ * @brief Sets the affinity and priority used by the next tasks of role. Workers already running keep theirs until their next task.
+ *
+ * @param role - WORKER_* role
+ * @param settings - Settings for the role
+ */
+void WorkerPool::setRoleSettings(int role, WorkerSettings const& settings) {
+    roleSettings[role] = settings;
+}
+
+
+
+/**
+ * @brief Gives task to the first idle worker of role, or to a new one if every worker of the role is busy.
+ *
+ * @param role - WORKER_* role
+ * @param task - Task to run
+ */
+void WorkerPool::runTask(int role, std::function<void()> task) {
+    for (std::unique_ptr<PipelineWorker>& worker : workers[role]) {
+        if (!worker->isBusy()) {
+            worker->run(std::move(task), roleSettings[role]);
+            return;
+        }
+    }
+
+    workers[role].emplace_back(new PipelineWorker());
+    workers[role].back()->run(std::move(task), roleSettings[role]);
+}
+
+
+
+/**
+ * @brief Blocks until every task of role has finished.
+ *
+ * @param role - WORKER_* role
+ */
+void WorkerPool::wait(int role) {
+    for (std::unique_ptr<PipelineWorker>& worker : workers[role]) {
+        worker->wait();
+    }
+}
+
+void WorkerPool::waitAll() {
+    for (int role = 0; role < NUM_WORKER_ROLES; role++) {
+        wait(role);
+    }
+}